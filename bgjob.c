@@ -0,0 +1,78 @@
+#include "bgjob.h"
+#include <stddef.h>
+
+// queued jobs, the head runs next
+static bgjob_t *bgjob_head = NULL;
+static bgjob_t *bgjob_tail = NULL;
+
+// tick at which the running chunk started
+static uint16_t bgjob_chunk_start = 0;
+
+// idle hook, runs one chunk of the job at the head of the queue
+static uint8_t bgjob_idle(void) {
+    bgjob_t *job = bgjob_head;
+    
+    if (job == NULL) {
+        return 0;
+    }
+    
+    // take the job off the head, it goes to the tail if it has more to do
+    bgjob_head = job->next;
+    if (bgjob_head == NULL) {
+        bgjob_tail = NULL;
+    }
+    job->next = NULL;
+    
+    bgjob_chunk_start = scheduler_get_ticks();
+    
+    if (job->function(job) == BGJOB_DONE) {
+        job->queued = 0;
+    } else if (bgjob_tail == NULL) {
+        bgjob_head = job;
+        bgjob_tail = job;
+    } else {
+        bgjob_tail->next = job;
+        bgjob_tail = job;
+    }
+    
+    return bgjob_head != NULL;
+}
+
+// empty the job queue
+void bgjob_init(void) {
+    bgjob_head = NULL;
+    bgjob_tail = NULL;
+    
+    scheduler_set_idle_hook(bgjob_idle);
+}
+
+// queue a job
+int8_t bgjob_add(bgjob_t *job, bgjob_func_t function) {
+    if (job == NULL || function == NULL) {
+        return -1;
+    }
+    
+    if (job->queued) {
+        return -1;
+    }
+    
+    job->function = function;
+    job->queued = 1;
+    job->next = NULL;
+    
+    if (bgjob_tail == NULL) {
+        bgjob_head = job;
+    } else {
+        bgjob_tail->next = job;
+    }
+    bgjob_tail = job;
+    
+    return 0;
+}
+
+// check whether the running chunk should return
+uint8_t bgjob_expired(void) {
+    uint16_t used = scheduler_get_ticks() - bgjob_chunk_start;
+    
+    return used >= BGJOB_BUDGET || scheduler_task_ready();
+}
@@ -0,0 +1,53 @@
+#ifndef BGJOB_H
+#define BGJOB_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+// background jobs
+// non-urgent work (checksums, eeprom housekeeping, statistics) that only
+// runs while no task is ready, from the scheduler's idle hook, before the
+// idle path sleeps. a job is a function that does one small chunk of work
+// per call and keeps its progress in a struct that embeds the bgjob_t.
+// queued jobs take turns one chunk at a time, and the scheduler runs a
+// task that became ready between two chunks, so a chunk is the longest
+// delay background work adds to a real task
+//
+// a chunk runs on the stack of the task that yielded to the idle path,
+// so keep it shallow, and it must not block or yield
+
+// ticks a chunk may take before bgjob_expired() ends it
+#ifndef BGJOB_BUDGET
+#define BGJOB_BUDGET 1
+#endif
+
+// values returned by a job function
+#define BGJOB_MORE 0    // call again for the next chunk
+#define BGJOB_DONE 1    // finished, taken off the queue
+
+struct bgjob;
+
+// job function, does one chunk and returns one of the BGJOB_ values above
+typedef uint8_t (*bgjob_func_t)(struct bgjob *job);
+
+// job state
+typedef struct bgjob {
+    bgjob_func_t function;      // called once per chunk
+    uint8_t queued;             // non-zero until the job is done
+    struct bgjob *next;         // next queued job
+} bgjob_t;
+
+// empty the job queue and install the idle hook, call after scheduler_init()
+void bgjob_init(void);
+
+// queue a job, it runs in the next idle time
+// call from main() or from a task, not from an isr
+// returns 0 on success, -1 if the job is already queued
+int8_t bgjob_add(bgjob_t *job, bgjob_func_t function);
+
+// returns non-zero once the running chunk should return: a task became
+// ready or the chunk has used up its BGJOB_BUDGET ticks
+// poll it from loops inside a chunk
+uint8_t bgjob_expired(void);
+
+#endif // BGJOB_H
@@ -1,50 +1,31 @@
 // debug statistics example using avr round robin scheduler
 // demonstrates debug tracing: system ticks, context switches, runtime, yields
-// prints stats via uart at 9600 baud
+// prints stats via the interrupt-driven uart driver at 9600 baud
 // target: arduino uno (atmega328p)
 // connections:
 //   - uart tx: arduino tx (connect to usb-serial)
 //   - led: pin 13 (pb5) - status indicator
 
 #include "scheduler.h"
+#include "uart.h"
 #include <avr/io.h>
 #include <stdio.h>
 
 #ifdef SCHEDULER_DEBUG
 
-// uart buffer for printf support
+// printf support on top of the interrupt-driven uart driver
 static int uart_putchar(char c, FILE *stream);
 static FILE uart_output = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
 
-// initialize uart for debug output (9600 baud @ 16MHz)
-void uart_init(void) {
-    // set baud rate to 9600 @ 16MHz
-    uint16_t ubrr = 103;  // 16MHz / (16 * 9600) - 1
-    
-    UBRR0H = (uint8_t)(ubrr >> 8);
-    UBRR0L = (uint8_t)ubrr;
-    
-    // enable transmitter
-    UCSR0B = (1 << TXEN0);
-    
-    // set frame format: 8 data bits, 1 stop bit, no parity
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-    
-    // set stdout to uart
-    stdout = &uart_output;
-}
-
-// send character via uart (for printf support)
+// queue character for the uart (blocks only while the tx buffer is full)
 static int uart_putchar(char c, FILE *stream) {
+    (void)stream;
+    
     if (c == '\n') {
-        uart_putchar('\r', stream);
+        uart_putc('\r');
     }
     
-    // wait for empty transmit buffer
-    while (!(UCSR0A & (1 << UDRE0)));
-    
-    // put data into buffer, sends the data
-    UDR0 = c;
+    uart_putc(c);
     
     return 0;
 }
@@ -86,6 +67,10 @@ void task_idle(void) {
     }
 }
 
+// consistent copy of the debug counters
+// kept static because it is too large for a task stack
+static scheduler_debug_snapshot_t snapshot;
+
 // task 4: debug statistics reporter - prints stats every 5 seconds
 void task_debug_reporter(void) {
     uint16_t report_interval = 5000;  // 5 seconds
@@ -94,8 +79,9 @@ void task_debug_reporter(void) {
     task_delay(report_interval);
     
     while (1) {
-        // get debug statistics
-        const scheduler_debug_t *stats = scheduler_get_debug_stats();
+        // get debug statistics (never disables interrupts)
+        scheduler_get_debug_snapshot(&snapshot);
+        const scheduler_debug_t *stats = &snapshot.system;
         
         // print header
         printf("\n========================================\n");
@@ -111,31 +97,47 @@ void task_debug_reporter(void) {
                    (stats->context_switches * 1000UL) / stats->total_ticks);
         }
         
+#ifdef SCHEDULER_CPU_LOAD
+        // print cpu load averages (idle task excluded)
+        scheduler_load_t load;
+        scheduler_get_cpu_load(&load);
+        printf("CPU Load 1s/10s:     %u/%u permille\n",
+               SCHEDULER_LOAD_TO_PERMILLE(load.load_1s),
+               SCHEDULER_LOAD_TO_PERMILLE(load.load_10s));
+        printf("Idle Ticks:          %lu\n", scheduler_get_idle_ticks());
+#endif
+        
         printf("\nPer-Task Statistics:\n");
         printf("----------------------------------------\n");
         
         // print statistics for each task
-        uint8_t task_count = scheduler_get_task_count();
-        for (uint8_t i = 0; i < task_count; i++) {
-            uint32_t runtime, scheduled;
+        for (uint8_t i = 0; i < snapshot.task_count; i++) {
+            uint32_t runtime = snapshot.runtime_ticks[i];
+            uint32_t scheduled = snapshot.times_scheduled[i];
+            
+            printf("Task %u: ", i);
+            printf("Runtime=%lu ticks ", runtime);
             
-            if (scheduler_get_task_stats(i, &runtime, &scheduled) == 0) {
-                printf("Task %u: ", i);
-                printf("Runtime=%lu ticks ", runtime);
-                
-                // calculate cpu percentage
-                if (stats->total_ticks > 0) {
-                    uint16_t cpu_percent = (uint16_t)((runtime * 100UL) / stats->total_ticks);
-                    printf("(%u%% CPU), ", cpu_percent);
-                }
-                
-                printf("Scheduled=%lu times\n", scheduled);
-                
-                // calculate average runtime per schedule
-                if (scheduled > 0) {
-                    uint32_t avg_runtime = runtime / scheduled;
-                    printf("        Avg Runtime: %lu ticks/schedule\n", avg_runtime);
-                }
+            // calculate cpu percentage
+            if (stats->total_ticks > 0) {
+                uint16_t cpu_percent = (uint16_t)((runtime * 100UL) / stats->total_ticks);
+                printf("(%u%% CPU), ", cpu_percent);
+            }
+            
+            printf("Scheduled=%lu times\n", scheduled);
+            
+#ifdef SCHEDULER_CPU_LOAD
+            if (scheduler_get_task_load(i, &load) == 0) {
+                printf("        Load 1s/10s: %u/%u permille\n",
+                       SCHEDULER_LOAD_TO_PERMILLE(load.load_1s),
+                       SCHEDULER_LOAD_TO_PERMILLE(load.load_10s));
+            }
+#endif
+            
+            // calculate average runtime per schedule
+            if (scheduled > 0) {
+                uint32_t avg_runtime = runtime / scheduled;
+                printf("        Avg Runtime: %lu ticks/schedule\n", avg_runtime);
             }
         }
         
@@ -158,7 +160,9 @@ void task_led_blink(void) {
 }
 
 int main(void) {
-    uart_init();
+    // 9600 baud, stdout goes to the uart
+    uart_init(9600);
+    stdout = &uart_output;
     
     printf("\n\n");
     printf("========================================\n");
@@ -179,8 +183,8 @@ int main(void) {
     printf("Tasks added: %u\n", scheduler_get_task_count());
     printf("Starting scheduler...\n\n");
     
-    // small delay to let uart finish
-    for (volatile uint32_t i = 0; i < 100000; i++);
+    // let the banner drain before the tasks start
+    uart_flush();
     
     scheduler_start();
     
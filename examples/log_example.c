@@ -0,0 +1,88 @@
+// deferred logging example using avr round robin scheduler
+// demonstrates the binary log ring: tasks log a format string id plus raw
+// arguments in a few cycles, a drain task streams the records over uart
+// and tools/logfmt.py formats them on the host:
+//   tools/logfmt.py log_example.elf /dev/ttyACM0 115200
+// target: arduino uno (atmega328p)
+// connections:
+//   - uart tx: arduino tx (connect to usb-serial)
+//   - led: pin 13 (pb5) - status indicator
+
+#include "scheduler.h"
+#include "log.h"
+#include "uart.h"
+#include <avr/io.h>
+
+// task 1: sensor simulation - logs a reading every 100ms
+void task_sensor(void) {
+    uint16_t reading = 0;
+    
+    while (1) {
+        reading += 7;
+        LOG1("sensor reading=%u", reading);
+        task_delay(100);
+    }
+}
+
+// task 2: led blinker - logs every state change
+void task_led_blink(void) {
+    uint8_t on = 0;
+    
+    DDRB |= (1 << PB5);
+    
+    while (1) {
+        on = !on;
+        PORTB ^= (1 << PB5);
+        LOG1("led %hhu", on);
+        task_delay(500);
+    }
+}
+
+// task 3: statistics - logs uptime and cpu load every second
+void task_stats(void) {
+    while (1) {
+        task_delay(1000);
+#if defined(SCHEDULER_DEBUG) && defined(SCHEDULER_CPU_LOAD)
+        scheduler_load_t load;
+        scheduler_get_cpu_load(&load);
+        LOG2("uptime=%lu ticks load=%u permille",
+             scheduler_get_debug_stats()->total_ticks,
+             SCHEDULER_LOAD_TO_PERMILLE(load.load_1s));
+#endif
+        LOG1("log records dropped=%u", log_get_dropped());
+    }
+}
+
+// task 4: log drain - streams pending records to the host
+// keeps the uart work out of the tasks that log
+void task_log_drain(void) {
+    uint8_t chunk[16];
+    uint8_t len;
+    
+    while (1) {
+        while ((len = log_read(chunk, sizeof(chunk))) > 0) {
+            uart_write(chunk, len);
+        }
+        task_delay(20);
+    }
+}
+
+int main(void) {
+    uart_init(115200);
+    log_init();
+    
+    LOG0("log example starting");
+    
+    scheduler_init();
+    
+    scheduler_add_task(task_sensor);
+    scheduler_add_task(task_led_blink);
+    scheduler_add_task(task_stats);
+    scheduler_add_task(task_log_drain);
+    
+    LOG1("tasks added: %hhu", scheduler_get_task_count());
+    
+    scheduler_start();
+    
+    return 0;
+}
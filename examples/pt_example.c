@@ -0,0 +1,71 @@
+// example application demonstrating stackless (pt) tasks
+// blinks twelve leds, each from its own pt task, next to one full-stack task
+// all blinkers share a single task stack, so they cost a few bytes each
+// target: arduino uno (atmega328p) or similar
+
+#include "scheduler.h"
+#include "pt.h"
+#include <avr/io.h>
+
+// blinkers on portb 0-5 (arduino d8-d13) and portd 2-7 (arduino d2-d7)
+#define BLINKERS 12
+
+// a pt task with its own parameters, the pt_t is embedded
+typedef struct {
+    pt_t pt;
+    volatile uint8_t *port;
+    uint8_t mask;
+    uint16_t period;
+} blinker_t;
+
+static blinker_t blinkers[BLINKERS];
+
+// toggle one led every period ticks
+static uint8_t blink(pt_t *pt) {
+    blinker_t *blinker = (blinker_t *)pt;
+    
+    PT_BEGIN(pt);
+    
+    while (1) {
+        *blinker->port ^= blinker->mask;
+        PT_DELAY(pt, blinker->period);
+    }
+    
+    PT_END(pt);
+}
+
+// full-stack task, runs alongside the blinkers
+void heartbeat_task(void) {
+    while (1) {
+        // stands in for application work that needs a real stack
+        task_delay(1000);
+    }
+}
+
+int main(void) {
+    DDRB |= 0x3F;
+    DDRD |= 0xFC;
+    
+    scheduler_init();
+    pt_init();
+    
+    scheduler_add_task(heartbeat_task);
+    
+    for (uint8_t i = 0; i < BLINKERS; i++) {
+        if (i < 6) {
+            blinkers[i].port = &PORTB;
+            blinkers[i].mask = 1 << i;
+        } else {
+            blinkers[i].port = &PORTD;
+            blinkers[i].mask = 1 << (i - 4);
+        }
+        
+        // 100 ms to 650 ms
+        blinkers[i].period = 100 + 50 * i;
+        pt_add(&blinkers[i].pt, blink);
+    }
+    
+    scheduler_start();
+    
+    return 0;
+}
@@ -11,6 +11,7 @@
 //   - motor b dir: pin 7 (pd7)
 
 #include "scheduler.h"
+#include "swtimer.h"
 #include <avr/io.h>
 
 // motor a pins
@@ -146,27 +147,30 @@ void safety_monitor_task(void) {
     }
 }
 
-// task 4: status indicator (blink led on pin 13)
-void status_led_task(void) {
-    // set pin 13 (pb5) as output
-    DDRB |= (1 << PB5);
-    
-    while (1) {
-        PORTB ^= (1 << PB5);  // toggle led
-        task_delay(1000);      // 1 second blink
-    }
+// status indicator (blink led on pin 13), a timer instead of a task
+static swtimer_t status_led_timer;
+
+static void status_led_toggle(swtimer_t *timer) {
+    (void)timer;
+    PORTB ^= (1 << PB5);  // toggle led
 }
 
 int main(void) {
     // initialize pwm for motors
     pwm_init();
     
+    // set pin 13 (pb5) as output
+    DDRB |= (1 << PB5);
+    
     scheduler_init();
+    swtimer_init();
     
     scheduler_add_task(motor_a_ramp_task);
     scheduler_add_task(motor_b_pulse_task);
     scheduler_add_task(safety_monitor_task);
-    scheduler_add_task(status_led_task);
+    
+    // 1 second blink
+    swtimer_start(&status_led_timer, status_led_toggle, 1000, 1000);
     
     scheduler_start();
     
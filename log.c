@@ -0,0 +1,112 @@
+#include "log.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#if (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) != 0 || LOG_BUFFER_SIZE > 128
+#error "LOG_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
+#define LOG_INDEX_MASK (LOG_BUFFER_SIZE - 1)
+
+// ring buffer with free-running 8-bit indices
+// head is only advanced by producers, tail only by the consumer
+static uint8_t log_buffer[LOG_BUFFER_SIZE];
+static volatile uint8_t log_head = 0;
+static volatile uint8_t log_tail = 0;
+static volatile uint16_t log_dropped = 0;
+
+// initialize the log ring
+void log_init(void) {
+    log_head = 0;
+    log_tail = 0;
+    log_dropped = 0;
+}
+
+// number of bytes waiting to be drained
+static uint8_t log_pending(void) {
+    return (uint8_t)(log_head - log_tail);
+}
+
+// store one byte at a free-running index
+static void log_put(uint8_t index, uint8_t byte) {
+    log_buffer[index & LOG_INDEX_MASK] = byte;
+}
+
+// append one record
+int8_t log_write(uint16_t id, const void *args, uint8_t len) {
+    const uint8_t *bytes = (const uint8_t *)args;
+    uint8_t size = LOG_HEADER_SIZE + len;
+    
+    // avr has no compare-and-swap, so producers (tasks and isrs) are
+    // serialised by a critical section bounded by LOG_MAX_ARGS bytes
+    // the drop counter is shared with them, so it is updated inside it too
+    uint8_t sreg = SREG;
+    cli();
+    
+    if (len > LOG_MAX_ARGS || (uint16_t)LOG_BUFFER_SIZE - log_pending() < size) {
+        log_dropped++;
+        SREG = sreg;
+        return -1;
+    }
+    
+    uint8_t head = log_head;
+    log_put(head++, LOG_SYNC);
+    log_put(head++, (uint8_t)(id & 0xFF));
+    log_put(head++, (uint8_t)(id >> 8));
+    log_put(head++, len);
+    for (uint8_t i = 0; i < len; i++) {
+        log_put(head++, bytes[i]);
+    }
+    
+    // publish the complete record to the consumer
+    log_head = head;
+    
+    SREG = sreg;
+    return 0;
+}
+
+// copy pending bytes out of the ring
+// lock-free: only the consumer moves the tail
+uint8_t log_read(uint8_t *buf, uint8_t len) {
+    uint8_t tail = log_tail;
+    uint8_t count = (uint8_t)(log_head - tail);
+    
+    if (count > len) {
+        count = len;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        buf[i] = log_buffer[tail++ & LOG_INDEX_MASK];
+    }
+    
+    log_tail = tail;
+    return count;
+}
+
+// send all pending bytes
+uint16_t log_drain(log_putc_t putc) {
+    uint16_t sent = 0;
+    uint8_t byte;
+    
+    if (putc == NULL) {
+        return 0;
+    }
+    
+    while (log_read(&byte, 1) == 1) {
+        putc(byte);
+        sent++;
+    }
+    
+    return sent;
+}
+
+// get dropped record count
+uint16_t log_get_dropped(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t dropped = log_dropped;
+    SREG = sreg;
+    
+    return dropped;
+}
@@ -0,0 +1,87 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+// deferred-formatting logger
+// a log call stores only a 16-bit format string id and the raw argument
+// bytes in a ring buffer, formatting happens on the host (tools/logfmt.py)
+// format strings live in the non-loaded .logstr elf section (see log.ld),
+// so they cost neither flash nor ram on the target
+
+// ring buffer size in bytes (power of two, at most 128)
+#define LOG_BUFFER_SIZE 64
+
+// maximum number of argument bytes per record
+#define LOG_MAX_ARGS 8
+
+// first byte of every record in the drained stream
+#define LOG_SYNC 0xA5
+
+// record layout: sync, id low, id high, argument length, argument bytes
+#define LOG_HEADER_SIZE 4
+
+// place a format string in the .logstr section and return its id
+// argument sizes follow avr-gcc: %c %hhu %hhd %hhx take 1 byte,
+// %d %u %x %i take 2 bytes, %ld %lu %lx take 4 bytes
+#define LOG_ID(fmt) __extension__({ \
+        static const char _log_fmt[] __attribute__((section(".logstr"), used)) = fmt; \
+        (uint16_t)(uintptr_t)_log_fmt; \
+    })
+
+// log a message with 0-4 arguments
+#define LOG0(fmt) \
+    log_write(LOG_ID(fmt), 0, 0)
+
+#define LOG1(fmt, a) \
+    do { \
+        __typeof__(a) _log_args = (a); \
+        log_write(LOG_ID(fmt), &_log_args, sizeof(_log_args)); \
+    } while (0)
+
+#define LOG2(fmt, a, b) \
+    do { \
+        struct __attribute__((packed)) { \
+            __typeof__(a) _0; __typeof__(b) _1; \
+        } _log_args = { (a), (b) }; \
+        log_write(LOG_ID(fmt), &_log_args, sizeof(_log_args)); \
+    } while (0)
+
+#define LOG3(fmt, a, b, c) \
+    do { \
+        struct __attribute__((packed)) { \
+            __typeof__(a) _0; __typeof__(b) _1; __typeof__(c) _2; \
+        } _log_args = { (a), (b), (c) }; \
+        log_write(LOG_ID(fmt), &_log_args, sizeof(_log_args)); \
+    } while (0)
+
+#define LOG4(fmt, a, b, c, d) \
+    do { \
+        struct __attribute__((packed)) { \
+            __typeof__(a) _0; __typeof__(b) _1; __typeof__(c) _2; __typeof__(d) _3; \
+        } _log_args = { (a), (b), (c), (d) }; \
+        log_write(LOG_ID(fmt), &_log_args, sizeof(_log_args)); \
+    } while (0)
+
+// byte sink used by log_drain(), e.g. a uart transmit function
+typedef void (*log_putc_t)(uint8_t byte);
+
+// initialize (empty) the log ring
+void log_init(void);
+
+// append one record, safe to call from tasks and isrs
+// returns 0 on success, -1 if the record was dropped (ring full or too long)
+int8_t log_write(uint16_t id, const void *args, uint8_t len);
+
+// copy up to len bytes of pending records into buf (single consumer)
+// returns the number of bytes copied
+uint8_t log_read(uint8_t *buf, uint8_t len);
+
+// send all pending bytes to putc (single consumer)
+// returns the number of bytes sent
+uint16_t log_drain(log_putc_t putc);
+
+// number of records dropped because the ring was full
+uint16_t log_get_dropped(void);
+
+#endif // LOG_H
@@ -0,0 +1,54 @@
+#ifndef PORT_H
+#define PORT_H
+
+#include "scheduler.h"
+
+// hardware port interface used by the scheduler core
+// port_avr.c implements it for avr, port_host.c runs the same core on a
+// development machine with real context switches (ucontext)
+
+// prepare a task so that the first switch to it enters task_function
+// and returning from task_function enters exit_handler
+void port_init_task(task_t *task, task_func_t task_function, task_func_t exit_handler);
+
+// load the context of the first task
+// never returns on avr, on the host it returns after port_host_stop()
+void port_start(task_t *task) SCHEDULER_NORETURN;
+
+// save the running context into from and resume to
+void port_switch(task_t *from, task_t *to);
+
+// called repeatedly by the idle task while no task is ready
+void port_idle(void);
+
+// scheduler core functions for port_idle(), call with interrupts disabled
+
+// account for ticks the tick isr missed while timer0 was stopped
+void scheduler_skip_ticks(uint16_t ticks);
+
+// record ticks spent sleeping in a sleep mode (SCHEDULER_SLEEP_MODE_...)
+void scheduler_count_sleep(uint8_t mode, uint16_t ticks);
+
+#ifdef HOST_TEST_BUILD
+// stop the scheduler from inside a task, scheduler_start() then returns
+void port_host_stop(void);
+
+// use a deterministic virtual clock (1) or the real-time clock (0, default)
+// in virtual time ticks only advance while every task is blocked (jumping
+// straight to the next wakeup) or through port_host_advance()
+void port_host_set_virtual_time(uint8_t enabled);
+
+// stop the scheduler once this many ticks have elapsed (0 = no limit)
+void port_host_set_tick_limit(uint32_t limit);
+
+// get ticks delivered since scheduler_start()
+uint32_t port_host_get_ticks(void);
+
+// let the running task consume ticks of cpu time (virtual time only)
+void port_host_advance(uint32_t ticks);
+
+// returns non-zero if the last run stopped because no task could wake up
+uint8_t port_host_deadlocked(void);
+#endif
+
+#endif // PORT_H
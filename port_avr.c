@@ -0,0 +1,299 @@
+#include "port.h"
+#include "uart.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+// avr port - context frame layout, from the top of the task stack down:
+//   return address (2 bytes, 3 on parts with a 3-byte pc), sreg,
+//   r2 ... r17, r28, r29
+// tasks only switch inside port_switch(), which is called like any other
+// function, so the abi already lets it clobber r0, r18-r27, r30, r31 and
+// rampz, and r1 is zero on entry; only the call-saved registers and sreg
+// (the interrupt flag of the switching task) are part of the frame
+// eind is never changed by compiled code, so all tasks share it
+// stack_pointer is the first member of task_t, so the assembly below
+// loads and stores it through the task pointer directly
+
+#ifdef SCHEDULER_PIN_REGISTERS
+// r2-r4 hold global scheduler state (see scheduler.c), not task state
+#define PORT_PUSH_PINNED
+#define PORT_POP_PINNED
+#define PORT_SAVED_REGS 15
+#else
+#define PORT_PUSH_PINNED \
+    "push r2             \n\t" \
+    "push r3             \n\t" \
+    "push r4             \n\t"
+#define PORT_POP_PINNED \
+    "pop  r4             \n\t" \
+    "pop  r3             \n\t" \
+    "pop  r2             \n\t"
+#define PORT_SAVED_REGS 18
+#endif
+
+// push sreg and the call-saved registers, leaves interrupts disabled
+#define PORT_SAVE_CONTEXT \
+    "in   r0, __SREG__   \n\t" \
+    "cli                 \n\t" \
+    "push r0             \n\t" \
+    PORT_PUSH_PINNED \
+    "push r5             \n\t" \
+    "push r6             \n\t" \
+    "push r7             \n\t" \
+    "push r8             \n\t" \
+    "push r9             \n\t" \
+    "push r10            \n\t" \
+    "push r11            \n\t" \
+    "push r12            \n\t" \
+    "push r13            \n\t" \
+    "push r14            \n\t" \
+    "push r15            \n\t" \
+    "push r16            \n\t" \
+    "push r17            \n\t" \
+    "push r28            \n\t" \
+    "push r29            \n\t"
+
+// pop the call-saved registers and sreg in the reverse order of PORT_SAVE_CONTEXT
+#define PORT_RESTORE_CONTEXT \
+    "pop  r29            \n\t" \
+    "pop  r28            \n\t" \
+    "pop  r17            \n\t" \
+    "pop  r16            \n\t" \
+    "pop  r15            \n\t" \
+    "pop  r14            \n\t" \
+    "pop  r13            \n\t" \
+    "pop  r12            \n\t" \
+    "pop  r11            \n\t" \
+    "pop  r10            \n\t" \
+    "pop  r9             \n\t" \
+    "pop  r8             \n\t" \
+    "pop  r7             \n\t" \
+    "pop  r6             \n\t" \
+    "pop  r5             \n\t" \
+    PORT_POP_PINNED \
+    "pop  r0             \n\t" \
+    "out  __SREG__, r0   \n\t"
+
+// load the stack pointer from the task in x (r27:r26)
+#define PORT_LOAD_SP \
+    "ld   r28, X+        \n\t" \
+    "ld   r29, X         \n\t" \
+    "out  __SP_L__, r28  \n\t" \
+    "out  __SP_H__, r29  \n\t"
+
+// build the initial frame so the first restore "returns" into the task
+void port_init_task(task_t *task, task_func_t task_function, task_func_t exit_handler) {
+    uint8_t *stack_top = task->stack_top;
+    uint16_t func_addr = (uint16_t)task_function;
+    uint16_t exit_addr = (uint16_t)exit_handler;
+    
+    // return address of the task function (task exit handler)
+    // code pointers are 16-bit word addresses, on parts with a 3-byte pc
+    // the linker routes them through stubs below 128 KiB, so the top byte is 0
+    *stack_top-- = exit_addr & 0xFF;
+    *stack_top-- = (exit_addr >> 8) & 0xFF;
+#ifdef __AVR_3_BYTE_PC__
+    *stack_top-- = 0x00;
+#endif
+    
+    // task function address (where the first restore returns to)
+    *stack_top-- = func_addr & 0xFF;
+    *stack_top-- = (func_addr >> 8) & 0xFF;
+#ifdef __AVR_3_BYTE_PC__
+    *stack_top-- = 0x00;
+#endif
+    
+    // sreg with interrupts enabled
+    *stack_top-- = 0x80;
+    
+    // r2-r17 (r5-r17 with pinned registers), r28, r29
+    for (uint8_t i = 0; i < PORT_SAVED_REGS; i++) {
+        *stack_top-- = 0x00;
+    }
+    
+    task->stack_pointer = stack_top;
+}
+
+// start the first task (task pointer in r25:r24)
+// the main() stack is abandoned
+void port_start(task_t *task) __attribute__((naked));
+void port_start(task_t *task __attribute__((unused))) {
+    asm volatile (
+        "cli                 \n\t"
+        "movw r26, r24       \n\t"
+        PORT_LOAD_SP
+        PORT_RESTORE_CONTEXT
+        "ret                 \n\t"
+    );
+    
+    __builtin_unreachable();
+}
+
+// cooperative context switch (from in r25:r24, to in r23:r22)
+// the return address into the caller is already on the stack
+void port_switch(task_t *from, task_t *to) __attribute__((naked, noinline));
+void port_switch(task_t *from __attribute__((unused)), task_t *to __attribute__((unused))) {
+    asm volatile (
+        PORT_SAVE_CONTEXT
+        // from->stack_pointer = sp
+        "movw r26, r24       \n\t"
+        "in   r0, __SP_L__   \n\t"
+        "st   X+, r0         \n\t"
+        "in   r0, __SP_H__   \n\t"
+        "st   X, r0          \n\t"
+        // sp = to->stack_pointer
+        "movw r26, r22       \n\t"
+        PORT_LOAD_SP
+        PORT_RESTORE_CONTEXT
+        "ret                 \n\t"
+    );
+}
+
+// tick rate set up by scheduler_init() (timer0, prescaler 64, 250 counts)
+#define PORT_TICK_HZ (F_CPU / 64UL / 250UL)
+
+// ticks from a timer2 wakeup until the cpu runs again (oscillator
+// start-up and timer2 synchronisation), slept off in idle mode instead
+#ifndef SCHEDULER_WAKEUP_TICKS
+#define SCHEDULER_WAKEUP_TICKS 2
+#endif
+
+// shortest gap worth power-save, shorter ones sleep in idle mode
+#ifndef SCHEDULER_POWER_SAVE_MIN_TICKS
+#define SCHEDULER_POWER_SAVE_MIN_TICKS 10
+#endif
+
+#if SCHEDULER_POWER_SAVE_MIN_TICKS <= SCHEDULER_WAKEUP_TICKS
+#error "SCHEDULER_POWER_SAVE_MIN_TICKS must be larger than SCHEDULER_WAKEUP_TICKS"
+#endif
+
+#ifdef SCHEDULER_SLEEP_POWER_SAVE
+// timer2 counts a 32.768 khz watch crystal on tosc1/tosc2, divided by 32
+// on the atmega328p tosc1/tosc2 are the xtal1/xtal2 pins, so the cpu must
+// run from the internal rc oscillator instead of the usual 16 mhz crystal
+#define PORT_T2_HZ 1024UL
+
+// longest sleep in timer2 counts: timer2 keeps counting while the cpu
+// wakes up, and the 8-bit difference measured afterwards must not wrap
+#define PORT_T2_MAX_COUNTS \
+    (255UL - (SCHEDULER_WAKEUP_TICKS * PORT_T2_HZ + PORT_TICK_HZ - 1) / PORT_TICK_HZ)
+
+#if PORT_T2_MAX_COUNTS < 128
+#error "SCHEDULER_WAKEUP_TICKS leaves too little of the 8-bit timer2 range"
+#endif
+
+static uint8_t port_t2_ready = 0;
+
+// part of a tick counted by timer2 but not yet passed on, in 1/PORT_T2_HZ
+static uint16_t port_t2_remainder = 0;
+
+// wait until writes to the asynchronous timer2 registers took effect
+static void port_t2_sync(void) {
+    while (ASSR & ((1 << TCN2UB) | (1 << OCR2AUB) | (1 << OCR2BUB) |
+                   (1 << TCR2AUB) | (1 << TCR2BUB))) {
+    }
+}
+
+// run timer2 free from the watch crystal
+static void port_t2_init(void) {
+    TIMSK2 = 0;
+    ASSR = (1 << AS2);
+    TCNT2 = 0;
+    TCCR2A = 0;
+    TCCR2B = (1 << CS21) | (1 << CS20);
+    port_t2_sync();
+    
+    // switching the clock source may have set them
+    TIFR2 = (1 << OCF2B) | (1 << OCF2A) | (1 << TOV2);
+    port_t2_ready = 1;
+}
+
+// the compare match only has to wake the cpu
+EMPTY_INTERRUPT(TIMER2_COMPA_vect);
+
+// sleep in power-save for up to the given ticks (interrupts disabled)
+// timer0 stops, so the ticks timer2 counted are handed to the scheduler
+static void port_power_save(uint16_t ticks) {
+    if (!port_t2_ready) {
+        port_t2_init();
+    }
+    
+    uint32_t counts = (uint32_t)ticks * PORT_T2_HZ / PORT_TICK_HZ;
+    
+    // longer gaps take several sleeps
+    if (counts > PORT_T2_MAX_COUNTS) {
+        counts = PORT_T2_MAX_COUNTS;
+    }
+    
+    uint8_t start = TCNT2;
+    
+    OCR2A = start + (uint8_t)counts;
+    port_t2_sync();
+    TIFR2 = (1 << OCF2A);
+    TIMSK2 = (1 << OCIE2A);
+    
+    set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+    
+    TIMSK2 = 0;
+    
+    // tcnt2 reads stale until a timer2 register write has gone through
+    OCR2B = 0;
+    port_t2_sync();
+    
+    uint8_t counted = TCNT2 - start;
+    uint32_t scaled = (uint32_t)counted * PORT_TICK_HZ + port_t2_remainder;
+    uint16_t elapsed = (uint16_t)(scaled / PORT_T2_HZ);
+    
+    port_t2_remainder = (uint16_t)(scaled % PORT_T2_HZ);
+    
+    scheduler_skip_ticks(elapsed);
+    scheduler_count_sleep(SCHEDULER_SLEEP_MODE_POWER_SAVE, elapsed);
+}
+#endif
+
+// sleep until something can happen
+// idle mode keeps timer0 and every peripheral running and wakes up on the
+// next tick, power-save (SCHEDULER_SLEEP_POWER_SAVE) covers a long gap
+// until the next delay ends with one timer2 wakeup
+void port_idle(void) {
+    cli();
+    
+    // an isr may have woken a task since the scheduler looked
+    if (scheduler_task_ready()) {
+        sei();
+        return;
+    }
+    
+#ifdef SCHEDULER_SLEEP_POWER_SAVE
+    uint16_t next = scheduler_next_wakeup();
+    
+    // with no delay pending only an isr can wake a task, so stay in idle
+    // mode where every peripheral interrupt still wakes the cpu
+    // power-save also stops the usart clock: a frame being sent would be
+    // cut off and a received byte could not wake a waiting reader
+    if (next >= SCHEDULER_POWER_SAVE_MIN_TICKS && !uart_idle_busy()) {
+        port_power_save(next - SCHEDULER_WAKEUP_TICKS);
+        sei();
+        return;
+    }
+#endif
+    
+    uint16_t start = scheduler_get_ticks();
+    
+    // sei delays interrupts by one instruction, so no wakeup is lost
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    
+    cli();
+    scheduler_count_sleep(SCHEDULER_SLEEP_MODE_IDLE, scheduler_get_ticks() - start);
+    sei();
+}
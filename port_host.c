@@ -0,0 +1,208 @@
+/*
+ * Host port for the AVR scheduler
+ *
+ * Runs the unmodified scheduler core on a development machine with real
+ * context switches: every task gets its own ucontext and a host-sized
+ * stack (the TCB stack is far too small for host code and libc).
+ *
+ * The timer0 interrupt is emulated from a monotonic clock. Elapsed
+ * milliseconds are delivered as ticks whenever the core switches tasks
+ * or idles, so no asynchronous signals interrupt the scheduler.
+ *
+ * With port_host_set_virtual_time(1) the wall clock is ignored: time
+ * only advances when every task is blocked (straight to the next wakeup)
+ * or when a task calls port_host_advance(). Runs are then deterministic
+ * and long delays are fast-forwarded.
+ *
+ * In SCHEDULER_REENTRANT builds all port state is thread-local, so every
+ * thread can run its own scheduler instance (see scheduler_set_instance()).
+ */
+
+#include "port.h"
+#include <avr/interrupt.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+
+// stack size of each host task
+#define HOST_STACK_SIZE (64 * 1024)
+
+// port state is per thread in reentrant builds
+#ifdef SCHEDULER_REENTRANT
+#define HOST_LOCAL static __thread
+#else
+#define HOST_LOCAL static
+#endif
+
+// timer0 compare interrupt handler from scheduler.c
+void TIMER0_COMPA_vect(void);
+
+// per-task host contexts, indexed by task id
+HOST_LOCAL ucontext_t task_contexts[MAX_TASKS];
+HOST_LOCAL uint8_t *task_stacks[MAX_TASKS];
+HOST_LOCAL task_func_t task_functions[MAX_TASKS];
+HOST_LOCAL task_func_t task_exit_handlers[MAX_TASKS];
+
+// context of the scheduler_start() caller
+HOST_LOCAL ucontext_t main_context;
+
+// the task currently holding the cpu
+HOST_LOCAL task_t *running_task = NULL;
+
+// last millisecond delivered as a tick (real time)
+HOST_LOCAL uint64_t last_tick_ms = 0;
+
+// clock mode and tick accounting
+HOST_LOCAL uint8_t virtual_time = 0;
+HOST_LOCAL uint32_t host_ticks = 0;
+HOST_LOCAL uint32_t tick_limit = 0;
+HOST_LOCAL uint8_t deadlocked = 0;
+
+// current monotonic time in milliseconds
+static uint64_t host_time_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+}
+
+// deliver one timer0 tick, stops the scheduler at the tick limit
+static void host_deliver_tick(void) {
+    host_ticks++;
+    TIMER0_COMPA_vect();
+    
+    if (tick_limit != 0 && host_ticks >= tick_limit) {
+        port_host_stop();
+    }
+}
+
+// deliver the ticks that elapsed since the last call
+// returns the number of ticks delivered
+static uint32_t host_poll_ticks(void) {
+    uint32_t delivered = 0;
+    
+    if (virtual_time) {
+        return 0;
+    }
+    
+    uint64_t now = host_time_ms();
+    while (last_tick_ms < now) {
+        last_tick_ms++;
+        host_deliver_tick();
+        delivered++;
+    }
+    
+    return delivered;
+}
+
+// first function executed on a task's host stack
+static void host_task_entry(int task_id) {
+    task_functions[task_id]();
+    task_exit_handlers[task_id]();
+}
+
+// prepare a task's host context
+void port_init_task(task_t *task, task_func_t task_function, task_func_t exit_handler) {
+    task_id_t id = task->task_id;
+    
+    if (task_stacks[id] == NULL) {
+        task_stacks[id] = malloc(HOST_STACK_SIZE);
+        if (task_stacks[id] == NULL) {
+            abort();
+        }
+    }
+    
+    task_functions[id] = task_function;
+    task_exit_handlers[id] = exit_handler;
+    
+    getcontext(&task_contexts[id]);
+    task_contexts[id].uc_stack.ss_sp = task_stacks[id];
+    task_contexts[id].uc_stack.ss_size = HOST_STACK_SIZE;
+    task_contexts[id].uc_link = NULL;
+    makecontext(&task_contexts[id], (void (*)(void))host_task_entry, 1, (int)id);
+    
+    // the avr stack is unused on the host
+    task->stack_pointer = task->stack_top;
+}
+
+// run the first task, returns once port_host_stop() is called
+void port_start(task_t *task) {
+    last_tick_ms = host_time_ms();
+    host_ticks = 0;
+    deadlocked = 0;
+    running_task = task;
+    swapcontext(&main_context, &task_contexts[task->task_id]);
+    running_task = NULL;
+}
+
+// switch between two task contexts
+void port_switch(task_t *from, task_t *to) {
+    host_poll_ticks();
+    
+    running_task = to;
+    swapcontext(&task_contexts[from->task_id], &task_contexts[to->task_id]);
+}
+
+// wait for the next tick without burning a whole core
+// in virtual time, jump straight to the next wakeup instead
+void port_idle(void) {
+    if (virtual_time) {
+        uint16_t next = scheduler_next_wakeup();
+        
+        if (next == 0) {
+            // nothing will ever become ready again
+            deadlocked = 1;
+            port_host_stop();
+            return;
+        }
+        
+        // the jump stands in for an idle-mode sleep
+        scheduler_count_sleep(SCHEDULER_SLEEP_MODE_IDLE, next);
+        port_host_advance(next);
+        return;
+    }
+    
+    if (host_poll_ticks() == 0) {
+        struct timespec pause = {0, 100000};  // 100 us
+        nanosleep(&pause, NULL);
+    }
+}
+
+// leave the scheduler and return from scheduler_start()
+void port_host_stop(void) {
+    if (running_task == NULL) {
+        return;
+    }
+    
+    swapcontext(&task_contexts[running_task->task_id], &main_context);
+}
+
+// select the virtual or the real-time clock
+void port_host_set_virtual_time(uint8_t enabled) {
+    virtual_time = enabled;
+}
+
+// stop the scheduler once the tick count reaches limit
+void port_host_set_tick_limit(uint32_t limit) {
+    tick_limit = limit;
+}
+
+// get ticks delivered since scheduler_start()
+uint32_t port_host_get_ticks(void) {
+    return host_ticks;
+}
+
+// consume cpu time in the running task (virtual time only)
+void port_host_advance(uint32_t ticks) {
+    if (!virtual_time) {
+        return;
+    }
+    
+    while (ticks-- > 0 && running_task != NULL) {
+        host_deliver_tick();
+    }
+}
+
+// check if the last run stopped because every task was blocked forever
+uint8_t port_host_deadlocked(void) {
+    return deadlocked;
+}
@@ -0,0 +1,109 @@
+#include "pt.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stddef.h>
+
+// pt tasks in the order they were added
+static pt_t *pt_head = NULL;
+static pt_t *pt_tail = NULL;
+
+// scheduler task running the pt tasks, -1 until the first pt_add()
+static task_sid_t pt_task_id = -1;
+
+// ticks until a delayed pt task is due, 0 once it is
+static uint16_t pt_ticks_left(const pt_t *pt, uint16_t now) {
+    uint16_t left = pt->wake - now;
+    
+    // past wake times wrap to large values
+    if (left >= 0x8000) {
+        return 0;
+    }
+    return left;
+}
+
+// shared scheduler task, runs every pt task in turn on its own stack
+static void pt_task(void) {
+    while (1) {
+        uint16_t sleep = 0xFFFF;
+        uint8_t busy = 0;
+        uint8_t delayed = 0;
+        
+        for (pt_t *pt = pt_head; pt != NULL; pt = pt->next) {
+            if (pt->status == PT_EXITED) {
+                continue;
+            }
+            
+            if (pt->status != PT_DELAYED ||
+                pt_ticks_left(pt, scheduler_get_ticks()) == 0) {
+                pt->status = pt->function(pt);
+            }
+            
+            if (pt->status == PT_DELAYED) {
+                uint16_t left = pt_ticks_left(pt, scheduler_get_ticks());
+                
+                if (left == 0) {
+                    busy = 1;
+                } else if (left < sleep) {
+                    sleep = left;
+                }
+                delayed = 1;
+            } else if (pt->status != PT_EXITED) {
+                busy = 1;
+            }
+        }
+        
+        if (busy) {
+            scheduler_yield();
+        } else if (delayed) {
+            // nothing to do before the earliest wakeup
+            task_delay(sleep);
+        } else {
+            // every pt task has exited, pt_add() wakes this task again
+            uint8_t sreg = SREG;
+            cli();
+            scheduler_block_current();
+            SREG = sreg;
+            scheduler_yield();
+        }
+    }
+}
+
+// forget all pt tasks
+void pt_init(void) {
+    pt_head = NULL;
+    pt_tail = NULL;
+    pt_task_id = -1;
+}
+
+// add a pt task
+int8_t pt_add(pt_t *pt, pt_func_t function) {
+    if (pt == NULL || function == NULL) {
+        return -1;
+    }
+    
+    if (pt_task_id < 0) {
+        pt_task_id = scheduler_add_task(pt_task);
+        if (pt_task_id < 0) {
+            return -1;
+        }
+    }
+    
+    pt->lc = 0;
+    pt->wake = 0;
+    pt->status = PT_YIELDED;
+    pt->function = function;
+    pt->next = NULL;
+    
+    // the shared task only walks the list between pt task calls
+    if (pt_tail == NULL) {
+        pt_head = pt;
+    } else {
+        pt_tail->next = pt;
+    }
+    pt_tail = pt;
+    
+    // in case every earlier pt task has exited
+    scheduler_wake_task((task_id_t)pt_task_id);
+    
+    return 0;
+}
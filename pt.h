@@ -0,0 +1,96 @@
+#ifndef PT_H
+#define PT_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+// stackless tasks (protothreads)
+// a pt task is a function that is called over and over and continues
+// where it left off, through a switch on the saved source line (duff's
+// device). every pt task runs on the stack of one shared scheduler task,
+// so it costs a pt_t instead of a TASK_STACK_SIZE stack
+// pt tasks and full-stack tasks take turns round-robin: the shared task
+// runs each ready pt task once, then yields like any other task
+//
+// limits of the technique:
+// - locals are lost across PT_YIELD(), PT_DELAY() and PT_WAIT_UNTIL(),
+//   keep state in statics or in a struct that embeds the pt_t
+// - no switch statement may enclose a PT_ macro in the task body
+// - blocking calls (task_delay(), uart_getc() ...) stall every pt task
+
+// values returned by a pt task function
+#define PT_WAITING 0    // condition not met yet, polled on every pass
+#define PT_YIELDED 1    // runs again on the next pass
+#define PT_DELAYED 2    // sleeps until the tick in wake
+#define PT_EXITED  3    // finished, never runs again
+
+struct pt;
+
+// pt task function, returns one of the PT_ values above
+typedef uint8_t (*pt_func_t)(struct pt *pt);
+
+// pt task state
+typedef struct pt {
+    uint16_t lc;            // local continuation (line to resume at)
+    uint16_t wake;          // tick at which PT_DELAY() ends
+    uint8_t status;         // last value returned by function
+    pt_func_t function;     // task body
+    struct pt *next;        // next pt task on the shared stack
+} pt_t;
+
+// the resume point of PT_WAIT_UNTIL() is reached by falling through
+#if defined(__GNUC__) && __GNUC__ >= 7
+#define PT_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define PT_FALLTHROUGH
+#endif
+
+// open and close a pt task body
+#define PT_BEGIN(pt) switch ((pt)->lc) { case 0:
+
+#define PT_END(pt) } (pt)->lc = 0; return PT_EXITED
+
+// give the cpu to every other task once (scheduler_yield())
+#define PT_YIELD(pt) \
+    do { \
+        (pt)->lc = __LINE__; \
+        return PT_YIELDED; \
+        case __LINE__:; \
+    } while (0)
+
+// sleep for the given number of ticks (task_delay()), at most 32767
+#define PT_DELAY(pt, ticks) \
+    do { \
+        (pt)->wake = scheduler_get_ticks() + (uint16_t)(ticks); \
+        (pt)->lc = __LINE__; \
+        return PT_DELAYED; \
+        case __LINE__:; \
+    } while (0)
+
+// continue only once condition is true, checked on every pass
+#define PT_WAIT_UNTIL(pt, condition) \
+    do { \
+        (pt)->lc = __LINE__; \
+        PT_FALLTHROUGH; \
+        case __LINE__: \
+        if (!(condition)) { \
+            return PT_WAITING; \
+        } \
+    } while (0)
+
+// end the pt task early
+#define PT_EXIT(pt) \
+    do { \
+        (pt)->lc = 0; \
+        return PT_EXITED; \
+    } while (0)
+
+// forget all pt tasks, call after scheduler_init()
+void pt_init(void);
+
+// add a pt task, the first call also adds the shared scheduler task
+// call from main() or from a task, not from an isr
+// returns 0 on success, -1 if the shared task could not be added
+int8_t pt_add(pt_t *pt, pt_func_t function);
+
+#endif // PT_H
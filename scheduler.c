@@ -1,87 +1,568 @@
 #include "scheduler.h"
+#include "port.h"
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <string.h>
+#ifdef SCHEDULER_REENTRANT
+#include <stdlib.h>
+#endif
+
+// returned by find_next_task() when no task is ready
+#define NO_TASK ((task_id_t)~0)
+
+#ifdef SCHEDULER_DEBUG
+// system-wide debug counters
+typedef struct {
+    debug_counter_t total_ticks;
+    debug_counter_t context_switches;
+    debug_counter_t voluntary_yields;
+#ifdef SCHEDULER_EDF
+    debug_counter_t deadline_misses;
+#endif
+} debug_counters_t;
+#endif
+
+#if defined(SCHEDULER_DEBUG) || defined(SCHEDULER_CPU_LOAD)
+#define SCHEDULER_STATS
+#endif
+
+#if !defined(SCHEDULER_STATS) && !defined(HOST_TEST_BUILD) && !defined(SCHEDULER_REENTRANT) && \
+    !defined(SCHEDULER_TICK_NOBLOCK)
+// without per-tick accounting the tick isr is hand-written: most ticks
+// only count the tick and the earliest delay (see TIMER0_COMPA_vect)
+#define SCHEDULER_TICK_FAST_PATH
+#endif
+
+#ifdef SCHEDULER_CPU_LOAD
+// moving average decay factors in q0.16 for one 128 tick window at 1 kHz
+// exp(-128 / 1000) and exp(-128 / 10000)
+#define LOAD_DECAY_1S  57662UL
+#define LOAD_DECAY_10S 64702UL
+#endif
+
+#if MAX_TASKS > 8
+// ready and sleeping sets as two-level bitmaps: one bit per task in groups
+// of 8, plus a summary with one bit per non-empty group, so the next ready
+// task is found in constant time however many tasks are configured
+// with up to 8 tasks the task table itself is scanned (no extra ram)
+#define SCHEDULER_TASK_BITMAP
+#define TASK_GROUPS ((MAX_TASKS + 7) / 8)
+
+#if TASK_GROUPS <= 8
+typedef uint8_t task_summary_t;
+#elif TASK_GROUPS <= 16
+typedef uint16_t task_summary_t;
+#else
+typedef uint32_t task_summary_t;
+#endif
+
+typedef struct {
+    task_summary_t summary;         // bit g set while bits[g] is non-zero
+    uint8_t bits[TASK_GROUPS];      // bit b of bits[g] is task g * 8 + b
+} task_bitmap_t;
+#endif
+
+// static task table, collected by the linker from SCHEDULER_TASK_DEFINE()
+// weak, so builds without any defined task see an empty table
+extern const scheduler_task_def_t __start_scheduler_tasks[] __attribute__((weak));
+extern const scheduler_task_def_t __stop_scheduler_tasks[] __attribute__((weak));
 
-// task control blocks
-static task_t tasks[MAX_TASKS];
-static uint8_t task_count = 0;
-static uint8_t current_task = 0;
-static volatile uint8_t scheduler_running = 0;
+#ifndef HOST_TEST_BUILD
+// task limit for the table size check in tasks.ld
+#define STR(x) #x
+#define XSTR(x) STR(x)
+asm (".global __scheduler_max_tasks\n\t"
+     ".set __scheduler_max_tasks, " XSTR(MAX_TASKS));
+#endif
 
+// complete scheduler state
+struct scheduler {
+    // task control blocks
+    task_t tasks[MAX_TASKS];
+    task_id_t task_count;
+    task_id_t static_tasks;     // leading tasks taken from the static table
+#ifndef SCHEDULER_PIN_REGISTERS
+    task_id_t current_task;
+    volatile uint8_t scheduler_running;
+    volatile uint8_t idle_running;
+#endif
+    volatile uint16_t ticks;     // free-running tick counter
+    scheduler_idle_hook_t idle_hook;  // background work while idle
+    uint32_t sleep_ticks[SCHEDULER_SLEEP_MODES];  // time asleep per mode
+    
+    // only the earliest delay is counted down on every tick, the others
+    // catch up by delay_elapsed when it ends (tick_wake()) or when a new
+    // delay starts (delay_flush()), so most ticks touch no task at all
+    uint16_t delay_due;          // ticks until the earliest wakeup, 0 = none
+    uint16_t delay_elapsed;      // ticks not yet taken off the delays
+    
+#ifdef SCHEDULER_TICK_NOBLOCK
+    uint8_t tick_busy;           // tick bookkeeping running, interrupts on
+    uint8_t tick_pending;        // ticks that arrived during it
+#endif
+    
+#if SCHEDULER_DYNAMIC_TASKS > 0
+    // stacks of the tasks added with scheduler_add_task()
+    uint8_t stacks[SCHEDULER_DYNAMIC_TASKS][TASK_STACK_SIZE];
+#endif
+    
+#ifdef SCHEDULER_TASK_BITMAP
+    task_bitmap_t ready;         // tasks in TASK_READY or TASK_RUNNING
+    task_bitmap_t sleeping;      // tasks with delay_ticks > 0
+#endif
+    
+#ifdef SCHEDULER_EDF
+    // ready tasks with a deadline, a binary min-heap on deadline_at
+    task_id_t edf_heap[MAX_TASKS];
+    task_id_t edf_count;
+#endif
+    
 #ifdef SCHEDULER_DEBUG
-// debug statistics
-static volatile scheduler_debug_t debug_stats = {0, 0, 0};
+    volatile debug_counters_t debug_counters;
+    
+    // 32-bit copy returned by scheduler_get_debug_stats()
+    scheduler_debug_t debug_stats;
+    
+    // set by scheduler_reset_debug_stats(), cleared by the tick isr
+    volatile uint8_t debug_reset_pending;
+#endif
+    
+#ifdef SCHEDULER_STATS
+    // sequence counter guarding the counters written by the tick isr
+    // odd while an update is in progress, readers retry if it changed
+    volatile uint8_t stats_sequence;
+#endif
+    
+#ifdef SCHEDULER_CPU_LOAD
+    // cpu load accounting, updated from the tick isr
+    uint8_t load_window_ticks;   // ticks elapsed in the current window
+    uint8_t idle_window_ticks;   // idle ticks in the current window
+    uint32_t idle_ticks;         // idle ticks since init
+    scheduler_load_t cpu_load;   // total (non-idle) utilisation
+#endif
+};
+
+#ifdef SCHEDULER_REENTRANT
+// one instance per simulation, selected per thread
+// threads that never select one share the default instance
+static scheduler_t default_scheduler;
+static __thread scheduler_t *current_scheduler = &default_scheduler;
+#define sched (*current_scheduler)
+#else
+// a single statically allocated instance
+static scheduler_t sched;
+#endif
+
+#ifdef SCHEDULER_PIN_REGISTERS
+// the state read on every tick and every yield lives in fixed registers,
+// so it is never loaded from sram and the tick isr does not save it
+// every file of the program must be built with -ffixed-r2 -ffixed-r3
+// -ffixed-r4, and port_avr.c leaves these registers out of the task frame
+// register variables cannot be volatile, every wait on them contains a call
+#if defined(HOST_TEST_BUILD) || defined(SCHEDULER_REENTRANT) || MAX_TASKS > 127
+#error "SCHEDULER_PIN_REGISTERS needs a single avr instance with 8-bit task ids"
+#endif
+register task_id_t sched_current_task asm("r2");
+register uint8_t sched_running asm("r3");
+register uint8_t sched_idle_running asm("r4");
+#else
+#define sched_current_task (sched.current_task)
+#define sched_running (sched.scheduler_running)
+#define sched_idle_running (sched.idle_running)
 #endif
 
 // forward declarations
-static uint8_t* init_stack(uint8_t *stack_top, task_func_t task_function);
 static void task_exit(void);
+static task_sid_t add_task(task_func_t task_function, uint8_t *stack_top);
+static void add_static_tasks(void);
+static task_id_t find_next_task(void);
+static task_id_t idle_task(void);
+#ifdef SCHEDULER_DEBUG
+static void debug_stats_clear_isr_counters(void);
 
-// initialize the scheduler
-void scheduler_init(void) {
-    task_count = 0;
-    current_task = 0;
-    scheduler_running = 0;
+// count one event, carrying into the upper half only on wrap
+static inline void debug_count(volatile debug_counter_t *counter) {
+    if (++counter->hot == 0) {
+        counter->folded++;
+    }
+}
+
+// count several events at once
+static inline void debug_count_add(volatile debug_counter_t *counter, uint16_t count) {
+    uint16_t hot = counter->hot + count;
     
-    // clear all task control blocks
-    memset(tasks, 0, sizeof(tasks));
+    if (hot < count) {
+        counter->folded++;
+    }
+    counter->hot = hot;
+}
+
+// fold a counter into its 32-bit value
+static inline uint32_t debug_count_read(const volatile debug_counter_t *counter) {
+    return ((uint32_t)counter->folded << 16) | counter->hot;
+}
+
+static inline void debug_count_clear(volatile debug_counter_t *counter) {
+    counter->hot = 0;
+    counter->folded = 0;
+}
+#endif
+
+#ifdef SCHEDULER_TASK_BITMAP
+// index of the lowest set bit in each nibble value
+static const uint8_t nibble_lowest_bit[16] = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
+// index of the lowest set bit, bits must be non-zero
+static inline uint8_t lowest_bit(uint8_t bits) {
+    if (bits & 0x0F) {
+        return nibble_lowest_bit[bits & 0x0F];
+    }
+    return 4 + nibble_lowest_bit[bits >> 4];
+}
+
+// index of the lowest set group, groups must be non-zero
+static inline uint8_t lowest_group(task_summary_t groups) {
+    uint8_t base = 0;
+    
+    // at most sizeof(task_summary_t) - 1 steps
+    while ((uint8_t)groups == 0) {
+        groups >>= 8;
+        base += 8;
+    }
+    
+    return base + lowest_bit((uint8_t)groups);
+}
+
+// add a task to a set (interrupts must be disabled)
+static inline void bitmap_set(task_bitmap_t *map, task_id_t id) {
+    uint8_t group = id >> 3;
+    
+    map->bits[group] |= (uint8_t)(1 << (id & 7));
+    map->summary |= (task_summary_t)1 << group;
+}
+
+// remove a task from a set (interrupts must be disabled)
+static inline void bitmap_clear(task_bitmap_t *map, task_id_t id) {
+    uint8_t group = id >> 3;
+    
+    map->bits[group] &= (uint8_t)~(1 << (id & 7));
+    if (map->bits[group] == 0) {
+        map->summary &= (task_summary_t)~((task_summary_t)1 << group);
+    }
+}
+
+// first task in a set with an id of at least from, NO_TASK if there is none
+static task_id_t bitmap_find(const task_bitmap_t *map, task_id_t from) {
+    if (from >= MAX_TASKS) {
+        return NO_TASK;
+    }
+    
+    uint8_t group = from >> 3;
+    uint8_t bits = map->bits[group] & (uint8_t)(0xFF << (from & 7));
+    
+    if (bits == 0) {
+        // groups above this one
+        task_summary_t groups = map->summary &
+            (task_summary_t)~(((task_summary_t)2 << group) - 1);
+        
+        if (groups == 0) {
+            return NO_TASK;
+        }
+        
+        group = lowest_group(groups);
+        bits = map->bits[group];
+    }
     
+    return (task_id_t)(group * 8 + lowest_bit(bits));
+}
+#endif
+
+#ifdef SCHEDULER_EDF
+// deadline ticks wrap, compare them by their difference
+static inline uint8_t edf_before(task_id_t a, task_id_t b) {
+    return (int16_t)(sched.tasks[a].deadline_at - sched.tasks[b].deadline_at) < 0;
+}
+
+static inline void edf_place(task_id_t pos, task_id_t id) {
+    sched.edf_heap[pos] = id;
+    sched.tasks[id].heap_index = pos;
+}
+
+// move the task at pos towards the root while it is due earlier
+static void edf_sift_up(task_id_t pos) {
+    task_id_t id = sched.edf_heap[pos];
+    
+    while (pos > 0) {
+        task_id_t parent = (pos - 1) / 2;
+        
+        if (!edf_before(id, sched.edf_heap[parent])) {
+            break;
+        }
+        edf_place(pos, sched.edf_heap[parent]);
+        pos = parent;
+    }
+    
+    edf_place(pos, id);
+}
+
+// move the task at pos towards the leaves while a child is due earlier
+static void edf_sift_down(task_id_t pos) {
+    task_id_t id = sched.edf_heap[pos];
+    
+    while (1) {
+        uint16_t child = 2 * (uint16_t)pos + 1;
+        
+        if (child >= sched.edf_count) {
+            break;
+        }
+        if (child + 1 < sched.edf_count &&
+            edf_before(sched.edf_heap[child + 1], sched.edf_heap[child])) {
+            child++;
+        }
+        if (!edf_before(sched.edf_heap[child], id)) {
+            break;
+        }
+        edf_place(pos, sched.edf_heap[child]);
+        pos = (task_id_t)child;
+    }
+    
+    edf_place(pos, id);
+}
+
+// release a job: due deadline ticks from now
+static void edf_push(task_id_t id) {
+    sched.tasks[id].deadline_at = sched.ticks + sched.tasks[id].deadline;
+    
+    task_id_t pos = sched.edf_count++;
+    sched.edf_heap[pos] = id;
+    edf_sift_up(pos);
+}
+
+static void edf_remove(task_id_t id) {
+    task_id_t pos = sched.tasks[id].heap_index;
+    task_id_t last = sched.edf_heap[--sched.edf_count];
+    
+    sched.tasks[id].heap_index = NO_TASK;
+    
+    // the last task fills the gap and moves to its place
+    if (pos < sched.edf_count) {
+        edf_place(pos, last);
+        edf_sift_up(pos);
+        edf_sift_down(sched.tasks[last].heap_index);
+    }
+}
+
+// track jobs of a task with a deadline across a state change
+// interrupts must be disabled
+static void edf_set_state(task_id_t id, task_state_t state) {
+    uint8_t ready = (state == TASK_READY || state == TASK_RUNNING);
+    
+    if (sched.tasks[id].deadline == 0) {
+        return;
+    }
+    
+    if (ready && sched.tasks[id].heap_index == NO_TASK) {
+        edf_push(id);
+    } else if (!ready && sched.tasks[id].heap_index != NO_TASK) {
+        edf_remove(id);
+        
 #ifdef SCHEDULER_DEBUG
-    // reset debug statistics
-    debug_stats.total_ticks = 0;
-    debug_stats.context_switches = 0;
-    debug_stats.voluntary_yields = 0;
+        // blocking ends the job, a suspended job is dropped uncounted
+        if (state == TASK_BLOCKED &&
+            (int16_t)(sched.ticks - sched.tasks[id].deadline_at) > 0) {
+            debug_count(&sched.tasks[id].deadline_misses);
+            debug_count(&sched.debug_counters.deadline_misses);
+        }
+#endif
+    }
+}
+#endif
+
+// change a task's state, keeping the ready set up to date
+static inline void task_set_state(task_id_t id, task_state_t state) {
+#ifdef SCHEDULER_EDF
+    // the tick isr releases jobs too
+    uint8_t edf_sreg = SREG;
+    cli();
+    edf_set_state(id, state);
+    SREG = edf_sreg;
 #endif
     
-    // configure timer0 for context switching (1ms tick)
-    // assuming 16MHz clock
-    TCCR0A = (1 << WGM01);  // ctc mode
-    TCCR0B = (1 << CS01) | (1 << CS00);  // prescaler 64
-    OCR0A = 249;  // 16MHz / 64 / 250 = 1000Hz (1ms)
-    TIMSK0 = (1 << OCIE0A);  // enable compare match interrupt
+#ifdef SCHEDULER_TASK_BITMAP
+    // the tick isr updates the same sets
+    uint8_t sreg = SREG;
+    cli();
+    
+    if (state == TASK_READY || state == TASK_RUNNING) {
+        bitmap_set(&sched.ready, id);
+    } else {
+        bitmap_clear(&sched.ready, id);
+    }
+    
+    sched.tasks[id].state = state;
+    SREG = sreg;
+#else
+    sched.tasks[id].state = state;
+#endif
 }
 
-// initialize a task's stack
-static uint8_t* init_stack(uint8_t *stack_top, task_func_t task_function) {
-#ifndef HOST_TEST_BUILD
-    uint16_t func_addr = (uint16_t)task_function;
+// set a task's delay counter, keeping the sleeping set up to date
+// interrupts must be disabled while the tick isr is running
+static inline void task_set_delay(task_id_t id, uint16_t ticks) {
+    sched.tasks[id].delay_ticks = ticks;
     
-    // simulate what the stack looks like after a context save
-    // push return address (task exit handler)
-    *stack_top-- = (uint16_t)task_exit & 0xFF;
-    *stack_top-- = ((uint16_t)task_exit >> 8) & 0xFF;
+#ifdef SCHEDULER_TASK_BITMAP
+    if (ticks > 0) {
+        bitmap_set(&sched.sleeping, id);
+    } else {
+        bitmap_clear(&sched.sleeping, id);
+    }
+#endif
+}
+
+// take elapsed ticks off a sleeping task's delay (tick isr)
+// returns the ticks left, 0 if the task woke up
+static inline uint16_t task_tick_delay(task_id_t id, uint16_t elapsed) {
+    uint16_t left = sched.tasks[id].delay_ticks - elapsed;
     
-    // push task function address (where task will start)
-    *stack_top-- = func_addr & 0xFF;
-    *stack_top-- = (func_addr >> 8) & 0xFF;
+    sched.tasks[id].delay_ticks = left;
+    if (left == 0) {
+#ifdef SCHEDULER_TASK_BITMAP
+        bitmap_clear(&sched.sleeping, id);
+#endif
+        // wake up task if delay expired
+        if (sched.tasks[id].state == TASK_BLOCKED) {
+            task_set_state(id, TASK_READY);
+        }
+    }
     
-    // push r0 (zero register)
-    *stack_top-- = 0x00;
+    return left;
+}
+
+// the earliest delay ends with this tick: apply every tick counted since
+// the last wakeup to all sleeping tasks and find the next wakeup (tick isr)
+static void tick_wake(void) {
+    uint16_t elapsed = sched.delay_elapsed + 1;
+    uint16_t due = 0;
     
-    // push sreg (status register) with interrupts enabled
-    *stack_top-- = 0x80;
+#ifdef SCHEDULER_TASK_BITMAP
+    for (task_id_t i = bitmap_find(&sched.sleeping, 0); i != NO_TASK;
+         i = bitmap_find(&sched.sleeping, i + 1)) {
+#else
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        if (sched.tasks[i].delay_ticks == 0) {
+            continue;
+        }
+#endif
+#ifdef SCHEDULER_TICK_NOBLOCK
+        // peripheral isrs may wake tasks while this loop runs
+        // scheduler_skip_ticks() calls this with interrupts disabled,
+        // so restore the flag instead of enabling them
+        uint8_t sreg = SREG;
+        cli();
+        uint16_t left = task_tick_delay(i, elapsed);
+        SREG = sreg;
+#else
+        uint16_t left = task_tick_delay(i, elapsed);
+#endif
+        
+        if (left != 0 && (due == 0 || left < due)) {
+            due = left;
+        }
+    }
     
-    // push r1-r31 (general purpose registers)
-    for (uint8_t i = 0; i < 31; i++) {
-        *stack_top-- = 0x00;
+    sched.delay_elapsed = 0;
+    sched.delay_due = due;
+}
+
+// apply the ticks counted since the last wakeup to all sleeping tasks
+// before a new delay starts (interrupts disabled), none of them ends here
+static void delay_flush(void) {
+    uint16_t elapsed = sched.delay_elapsed;
+    
+    if (elapsed == 0) {
+        return;
     }
+    
+#ifdef SCHEDULER_TASK_BITMAP
+    for (task_id_t i = bitmap_find(&sched.sleeping, 0); i != NO_TASK;
+         i = bitmap_find(&sched.sleeping, i + 1)) {
 #else
-    // Host test build - just initialize the stack to something valid
-    // Real stack initialization only works on AVR hardware
-    (void)task_function;  // Suppress unused parameter warning
-    (void)task_exit;      // Suppress unused function warning
-    for (uint8_t i = 0; i < 35; i++) {
-        *stack_top-- = 0x00;
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        if (sched.tasks[i].delay_ticks == 0) {
+            continue;
+        }
+#endif
+        sched.tasks[i].delay_ticks -= elapsed;
     }
+    
+    sched.delay_elapsed = 0;
+}
+
+// initialize the scheduler
+void scheduler_init(void) {
+    sched.task_count = 0;
+    sched_current_task = 0;
+    sched_running = 0;
+    sched_idle_running = 0;
+    sched.ticks = 0;
+    sched.idle_hook = NULL;
+    memset(sched.sleep_ticks, 0, sizeof(sched.sleep_ticks));
+    sched.delay_due = 0;
+    sched.delay_elapsed = 0;
+#ifdef SCHEDULER_TICK_NOBLOCK
+    sched.tick_busy = 0;
+    sched.tick_pending = 0;
+#endif
+    
+    // clear all task control blocks
+    memset(sched.tasks, 0, sizeof(sched.tasks));
+    
+#ifdef SCHEDULER_TASK_BITMAP
+    memset(&sched.ready, 0, sizeof(sched.ready));
+    memset(&sched.sleeping, 0, sizeof(sched.sleeping));
 #endif
     
-    return stack_top;
+#ifdef SCHEDULER_EDF
+    sched.edf_count = 0;
+#endif
+    
+#ifdef SCHEDULER_DEBUG
+    // reset debug statistics
+    debug_count_clear(&sched.debug_counters.total_ticks);
+    debug_count_clear(&sched.debug_counters.context_switches);
+    debug_count_clear(&sched.debug_counters.voluntary_yields);
+#ifdef SCHEDULER_EDF
+    debug_count_clear(&sched.debug_counters.deadline_misses);
+#endif
+    sched.debug_reset_pending = 0;
+#endif
+    
+#ifdef SCHEDULER_CPU_LOAD
+    // reset cpu load meter
+    sched.load_window_ticks = 0;
+    sched.idle_window_ticks = 0;
+    sched.idle_ticks = 0;
+    sched.cpu_load.load_1s = 0;
+    sched.cpu_load.load_10s = 0;
+#endif
+    
+    // configure timer0 for context switching (1ms tick)
+    // assuming 16MHz clock
+    TCCR0A = (1 << WGM01);  // ctc mode
+    TCCR0B = (1 << CS01) | (1 << CS00);  // prescaler 64
+    OCR0A = 249;  // 16MHz / 64 / 250 = 1000Hz (1ms)
+    TIMSK0 = (1 << OCIE0A);  // enable compare match interrupt
+    
+    add_static_tasks();
 }
 
 // task exit handler (called if task function returns)
 static void task_exit(void) {
     // mark task as blocked if it returns
-    tasks[current_task].state = TASK_BLOCKED;
+    task_set_state(sched_current_task, TASK_BLOCKED);
     
     // yield to next task
     while(1) {
@@ -89,191 +570,559 @@ static void task_exit(void) {
     }
 }
 
-// add a new task to the scheduler
-int8_t scheduler_add_task(task_func_t task_function) {
-    if (task_count >= MAX_TASKS || task_function == NULL) {
-        return -1;
-    }
-    
-    uint8_t task_id = task_count;
+// set up the next task control block on the given stack
+static task_sid_t add_task(task_func_t task_function, uint8_t *stack_top) {
+    task_id_t task_id = sched.task_count;
     
     // initialize task control block
-    tasks[task_id].task_id = task_id;
-    tasks[task_id].state = TASK_READY;
-    tasks[task_id].delay_ticks = 0;
+    sched.tasks[task_id].task_id = task_id;
+    sched.tasks[task_id].stack_top = stack_top;
+    sched.tasks[task_id].delay_ticks = 0;
+#ifdef SCHEDULER_EDF
+    sched.tasks[task_id].deadline = 0;
+    sched.tasks[task_id].heap_index = NO_TASK;
+#endif
+    task_set_state(task_id, TASK_READY);
     
-    // initialize stack (point to top of stack)
-    uint8_t *stack_top = &tasks[task_id].stack[TASK_STACK_SIZE - 1];
-    tasks[task_id].stack_pointer = init_stack(stack_top, task_function);
+    // build the initial context (returning from the task enters task_exit)
+    port_init_task(&sched.tasks[task_id], task_function, task_exit);
     
-    task_count++;
+    sched.task_count++;
     
     return task_id;
 }
 
+// copy one static task descriptor out of flash
+static void read_task_def(task_id_t index, scheduler_task_def_t *def) {
+#ifdef __AVR_HAVE_ELPM__
+    // the table follows the code and may lie above 64 KiB
+    memcpy_PF(def, pgm_get_far_address(__start_scheduler_tasks) + index * sizeof(*def),
+              sizeof(*def));
+#else
+    memcpy_P(def, &__start_scheduler_tasks[index], sizeof(*def));
+#endif
+}
+
+// add the static task table, highest priority first
+static void add_static_tasks(void) {
+    task_id_t count = (task_id_t)(__stop_scheduler_tasks - __start_scheduler_tasks);
+    scheduler_task_def_t def;
+    uint16_t priority = 0x100;
+    
+    // one pass per distinct priority, the table is at most MAX_TASKS long
+    // (checked by the linker on avr)
+    while (sched.task_count < count && sched.task_count < MAX_TASKS) {
+        uint8_t next = 0;
+        
+        // highest priority below the previous pass
+        for (task_id_t i = 0; i < count; i++) {
+            read_task_def(i, &def);
+            if (def.priority < priority && def.priority >= next) {
+                next = def.priority;
+            }
+        }
+        
+        for (task_id_t i = 0; i < count && sched.task_count < MAX_TASKS; i++) {
+            read_task_def(i, &def);
+            if (def.priority == next && def.function != NULL) {
+                add_task(def.function, def.stack_top);
+            }
+        }
+        
+        if (next == 0) {
+            break;
+        }
+        priority = next;
+    }
+    
+    sched.static_tasks = sched.task_count;
+}
+
+// add a new task to the scheduler
+task_sid_t scheduler_add_task(task_func_t task_function) {
+#if SCHEDULER_DYNAMIC_TASKS > 0
+    task_id_t stack = sched.task_count - sched.static_tasks;
+    
+    if (sched.task_count >= MAX_TASKS || stack >= SCHEDULER_DYNAMIC_TASKS ||
+        task_function == NULL) {
+        return -1;
+    }
+    
+    return add_task(task_function, &sched.stacks[stack][TASK_STACK_SIZE - 1]);
+#else
+    (void)task_function;
+    return -1;
+#endif
+}
+
 // start the scheduler
 void scheduler_start(void) {
-    if (task_count == 0) {
+    if (sched.task_count == 0) {
         // no tasks to run
         while(1);
     }
     
     // set first task as running
-    current_task = 0;
-    tasks[current_task].state = TASK_RUNNING;
-    scheduler_running = 1;
+    sched_current_task = 0;
+#ifdef SCHEDULER_EDF
+    if (sched.edf_count != 0) {
+        sched_current_task = sched.edf_heap[0];
+    }
+#endif
+    task_set_state(sched_current_task, TASK_RUNNING);
+    sched_running = 1;
     
-    // enable global interrupts
-    sei();
+    // load the first task's context
+    // its initial sreg enables global interrupts
+    port_start(&sched.tasks[sched_current_task]);
     
-#ifndef HOST_TEST_BUILD
-    // load the first task's context and start running
-    // this is done by manually restoring the first task's stack
-    uint8_t *sp = tasks[current_task].stack_pointer;
+    // only the host port returns here, after port_host_stop()
+    sched_running = 0;
+}
+
+#ifdef SCHEDULER_CPU_LOAD
+// convert ticks in one window to a q0.16 load sample
+static uint16_t load_sample(uint8_t ticks) {
+    if (ticks >= SCHEDULER_LOAD_WINDOW) {
+        return 0xFFFF;
+    }
+    return (uint16_t)(((uint32_t)ticks << 16) / SCHEDULER_LOAD_WINDOW);
+}
+
+// fold one sample into a q0.16 exponential moving average
+static uint16_t load_ema(uint16_t average, uint16_t sample, uint32_t decay) {
+    return (uint16_t)(((uint32_t)average * decay +
+                       (uint32_t)sample * (65536UL - decay)) >> 16);
+}
+
+// fold one sample into both moving averages
+static void load_update(scheduler_load_t *load, uint8_t ticks) {
+    uint16_t sample = load_sample(ticks);
     
-    // set stack pointer and jump to task
-    asm volatile (
-        "out __SP_L__, %A0 \n\t"
-        "out __SP_H__, %B0 \n\t"
-        :
-        : "r" (sp)
-    );
+    load->load_1s = load_ema(load->load_1s, sample, LOAD_DECAY_1S);
+    load->load_10s = load_ema(load->load_10s, sample, LOAD_DECAY_10S);
+}
+
+// close the current load window (called from the tick isr)
+static void load_window_end(void) {
+    load_update(&sched.cpu_load, SCHEDULER_LOAD_WINDOW - sched.idle_window_ticks);
+    
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        load_update(&sched.tasks[i].load, sched.tasks[i].load_window_ticks);
+        sched.tasks[i].load_window_ticks = 0;
+    }
     
-    // restore registers and start task
+    sched.load_window_ticks = 0;
+    sched.idle_window_ticks = 0;
+}
+#endif
+
+#ifdef SCHEDULER_TICK_FAST_PATH
+// tick interrupt, hand-written: counts the tick and the earliest delay
+// using r24, r25 and sreg only, and saves the remaining call-clobbered
+// registers for tick_wake() only on the tick that ends a delay
+// the operands are link-time constants, so no register is allocated
+ISR(TIMER0_COMPA_vect, ISR_NAKED) {
     asm volatile (
-        "pop r31 \n\t"
-        "pop r30 \n\t"
-        "pop r29 \n\t"
-        "pop r28 \n\t"
-        "pop r27 \n\t"
-        "pop r26 \n\t"
-        "pop r25 \n\t"
-        "pop r24 \n\t"
-        "pop r23 \n\t"
-        "pop r22 \n\t"
-        "pop r21 \n\t"
-        "pop r20 \n\t"
-        "pop r19 \n\t"
-        "pop r18 \n\t"
-        "pop r17 \n\t"
-        "pop r16 \n\t"
-        "pop r15 \n\t"
-        "pop r14 \n\t"
-        "pop r13 \n\t"
-        "pop r12 \n\t"
-        "pop r11 \n\t"
-        "pop r10 \n\t"
-        "pop r9  \n\t"
-        "pop r8  \n\t"
-        "pop r7  \n\t"
-        "pop r6  \n\t"
-        "pop r5  \n\t"
-        "pop r4  \n\t"
-        "pop r3  \n\t"
-        "pop r2  \n\t"
-        "pop r1  \n\t"
-        "out __SREG__, r1 \n\t"
-        "pop r1  \n\t"
-        "pop r0  \n\t"
-        "ret     \n\t"
+        "push r24                \n\t"
+        "in   r24, __SREG__      \n\t"
+        "push r24                \n\t"
+        "push r25                \n\t"
+#ifdef SCHEDULER_PIN_REGISTERS
+        "tst  r3                 \n\t"
+#else
+        "lds  r24, %[running]    \n\t"
+        "tst  r24                \n\t"
+#endif
+        "breq 1f                 \n\t"
+        // ticks++
+        "lds  r24, %[ticks]      \n\t"
+        "lds  r25, %[ticks]+1    \n\t"
+        "adiw r24, 1             \n\t"
+        "sts  %[ticks]+1, r25    \n\t"
+        "sts  %[ticks], r24      \n\t"
+        // no delay pending (borrow) or the earliest one ends (zero)
+        "lds  r24, %[due]        \n\t"
+        "lds  r25, %[due]+1      \n\t"
+        "sbiw r24, 1             \n\t"
+        "brcs 1f                 \n\t"
+        "breq 2f                 \n\t"
+        "sts  %[due]+1, r25      \n\t"
+        "sts  %[due], r24        \n\t"
+        "lds  r24, %[elapsed]    \n\t"
+        "lds  r25, %[elapsed]+1  \n\t"
+        "adiw r24, 1             \n\t"
+        "sts  %[elapsed]+1, r25  \n\t"
+        "sts  %[elapsed], r24    \n\t"
+        "1:                      \n\t"
+        "pop  r25                \n\t"
+        "pop  r24                \n\t"
+        "out  __SREG__, r24      \n\t"
+        "pop  r24                \n\t"
+        "reti                    \n\t"
+        // full path, the rest of the compiler's isr frame
+        "2:                      \n\t"
+        "push r0                 \n\t"
+        "push r1                 \n\t"
+        "clr  r1                 \n\t"
+        "push r18                \n\t"
+        "push r19                \n\t"
+        "push r20                \n\t"
+        "push r21                \n\t"
+        "push r22                \n\t"
+        "push r23                \n\t"
+        "push r26                \n\t"
+        "push r27                \n\t"
+        "push r30                \n\t"
+        "push r31                \n\t"
+#ifdef __AVR_HAVE_JMP_CALL__
+        "call %x[wake]           \n\t"
+#else
+        "rcall %x[wake]          \n\t"
+#endif
+        "pop  r31                \n\t"
+        "pop  r30                \n\t"
+        "pop  r27                \n\t"
+        "pop  r26                \n\t"
+        "pop  r23                \n\t"
+        "pop  r22                \n\t"
+        "pop  r21                \n\t"
+        "pop  r20                \n\t"
+        "pop  r19                \n\t"
+        "pop  r18                \n\t"
+        "pop  r1                 \n\t"
+        "pop  r0                 \n\t"
+        "rjmp 1b                 \n\t"
+        :: [ticks] "i" (&sched.ticks),
+           [due] "i" (&sched.delay_due),
+           [elapsed] "i" (&sched.delay_elapsed),
+#ifndef SCHEDULER_PIN_REGISTERS
+           [running] "i" (&sched.scheduler_running),
+#endif
+           [wake] "i" (tick_wake)
     );
+}
+#else
+// the running task's entry for the tick isr, NULL if there is none
+static inline task_t *tick_current_task(void) {
+#ifdef SCHEDULER_PIN_REGISTERS
+    // library code built without -ffixed-r2 may hold its own value in r2
+    // when the tick arrives, so check the index before it addresses memory
+    task_id_t current = sched_current_task;
     
-    // should never reach here
-    while(1);
+    if (current >= sched.task_count) {
+        return NULL;
+    }
+    return &sched.tasks[current];
 #else
-    // Host test build - scheduler_start doesn't actually run tasks
-    // This is just for testing initialization logic
-    (void)tasks;  // Suppress unused variable warning
+    return &sched.tasks[sched_current_task];
 #endif
 }
 
-// timer interrupt - triggers context switch
-// simplified version using normal isr (not naked)
-// the avr isr macro already saves sreg and other necessary registers
-ISR(TIMER0_COMPA_vect) {
-    if (!scheduler_running || task_count == 0) {
-        return;
-    }
+// statistics and delay bookkeeping of one tick (tick isr)
+static inline void tick_process(void) {
+#if defined(SCHEDULER_DEBUG) || defined(SCHEDULER_CPU_LOAD)
+    task_t *current = tick_current_task();
+#endif
+    
+#ifdef SCHEDULER_STATS
+    // begin counter update (sequence becomes odd)
+    sched.stats_sequence++;
+#endif
     
 #ifdef SCHEDULER_DEBUG
+    // apply a reset requested from task context
+    if (sched.debug_reset_pending) {
+        debug_stats_clear_isr_counters();
+        sched.debug_reset_pending = 0;
+    }
+    
     // increment total system ticks
-    debug_stats.total_ticks++;
+    debug_count(&sched.debug_counters.total_ticks);
     
     // track runtime for current task
-    if (tasks[current_task].state == TASK_RUNNING) {
-        tasks[current_task].runtime_ticks++;
+    if (current != NULL && current->state == TASK_RUNNING) {
+        debug_count(&current->runtime_ticks);
     }
 #endif
     
-    // process delay timers for all tasks
-    for (uint8_t i = 0; i < task_count; i++) {
-        if (tasks[i].delay_ticks > 0) {
-            tasks[i].delay_ticks--;
-            // wake up task if delay expired
-            if (tasks[i].delay_ticks == 0 && tasks[i].state == TASK_BLOCKED) {
-                tasks[i].state = TASK_READY;
-            }
+#ifdef SCHEDULER_CPU_LOAD
+    // account this tick to the idle task or to the running task
+    if (sched_idle_running) {
+        sched.idle_ticks++;
+        sched.idle_window_ticks++;
+    } else if (current != NULL && current->state == TASK_RUNNING) {
+        current->load_window_ticks++;
+    }
+    
+    if (++sched.load_window_ticks >= SCHEDULER_LOAD_WINDOW) {
+        load_window_end();
+    }
+#endif
+    
+#ifdef SCHEDULER_STATS
+    // end counter update (sequence becomes even)
+    sched.stats_sequence++;
+#endif
+    
+    // count down the earliest delay, the others catch up when it ends
+    if (sched.delay_due != 0) {
+        if (--sched.delay_due == 0) {
+            tick_wake();
+        } else {
+            sched.delay_elapsed++;
         }
     }
 }
 
+#ifdef SCHEDULER_TICK_NOBLOCK
+// timer interrupt, nestable: only the tick count and the reentrancy guard
+// run with interrupts disabled, peripheral isrs preempt the bookkeeping
+// a tick arriving meanwhile is counted and processed by the running one
+ISR(TIMER0_COMPA_vect) {
+    if (!sched_running || sched.task_count == 0) {
+        return;
+    }
+    
+    sched.ticks++;
+    
+    if (sched.tick_busy) {
+        sched.tick_pending++;
+        return;
+    }
+    sched.tick_busy = 1;
+    
+    uint8_t pending;
+    
+    do {
+        sei();
+        tick_process();
+        cli();
+        
+        // run the ticks that arrived during the bookkeeping
+        pending = sched.tick_pending;
+        if (pending) {
+            sched.tick_pending = pending - 1;
+        }
+    } while (pending);
+    
+    // interrupts stay disabled until reti, after the guard is released
+    sched.tick_busy = 0;
+}
+#else
+// timer interrupt - counts ticks, statistics and delays
+// the avr isr macro already saves sreg and other necessary registers
+ISR(TIMER0_COMPA_vect) {
+    if (!sched_running || sched.task_count == 0) {
+        return;
+    }
+    
+    sched.ticks++;
+    tick_process();
+}
+#endif
+#endif
+
+#ifdef SCHEDULER_STATS
+// start a lock-free read of counters written by the tick isr
+static uint8_t stats_read_begin(void) {
+    uint8_t sequence = sched.stats_sequence;
+    
+    // counters must not be read before the sequence
+    asm volatile ("" ::: "memory");
+    return sequence;
+}
+
+// returns non-zero if the tick isr updated the counters during the read
+static uint8_t stats_read_retry(uint8_t sequence) {
+    // counters must be read before the sequence is checked again
+    asm volatile ("" ::: "memory");
+    return (sequence & 1) || sequence != sched.stats_sequence;
+}
+#endif
+
 // suspend a task
-void scheduler_suspend_task(uint8_t task_id) {
-    if (task_id < task_count) {
-        tasks[task_id].state = TASK_SUSPENDED;
+void scheduler_suspend_task(task_id_t task_id) {
+    if (task_id < sched.task_count) {
+        task_set_state(task_id, TASK_SUSPENDED);
     }
 }
 
 // resume a suspended task
-void scheduler_resume_task(uint8_t task_id) {
-    if (task_id < task_count && tasks[task_id].state == TASK_SUSPENDED) {
-        tasks[task_id].state = TASK_READY;
+void scheduler_resume_task(task_id_t task_id) {
+    if (task_id < sched.task_count && sched.tasks[task_id].state == TASK_SUSPENDED) {
+        task_set_state(task_id, TASK_READY);
+    }
+}
+
+// block current task until woken
+void scheduler_block_current(void) {
+    // no delay, so the tick isr leaves the task blocked
+    task_set_delay(sched_current_task, 0);
+    task_set_state(sched_current_task, TASK_BLOCKED);
+}
+
+// wake a blocked task
+void scheduler_wake_task(task_id_t task_id) {
+    // tasks sleeping in task_delay() are left to the tick isr
+    if (task_id < sched.task_count && sched.tasks[task_id].state == TASK_BLOCKED &&
+        sched.tasks[task_id].delay_ticks == 0) {
+        task_set_state(task_id, TASK_READY);
+    }
+}
+
+// wake a blocked task, cutting its delay short
+void scheduler_wake_early(task_id_t task_id) {
+    // the tick isr counts delays down
+    uint8_t sreg = SREG;
+    cli();
+    
+    if (task_id < sched.task_count && sched.tasks[task_id].state == TASK_BLOCKED) {
+        task_set_delay(task_id, 0);
+        task_set_state(task_id, TASK_READY);
     }
+    
+    SREG = sreg;
+}
+
+#ifdef SCHEDULER_EDF
+// set a task's relative deadline
+int8_t scheduler_set_deadline(task_id_t task_id, uint16_t deadline) {
+    if (task_id >= sched.task_count || deadline > 0x7FFF) {
+        return -1;
+    }
+    
+    uint8_t sreg = SREG;
+    cli();
+    
+    // a ready task releases a job with the new deadline right away
+    if (sched.tasks[task_id].heap_index != NO_TASK) {
+        edf_remove(task_id);
+    }
+    sched.tasks[task_id].deadline = deadline;
+    edf_set_state(task_id, sched.tasks[task_id].state);
+    
+    SREG = sreg;
+    return 0;
+}
+#endif
+
+// find the next ready task after the current one (round-robin)
+// the current task is picked again if it is still running and nothing else is ready
+static task_id_t find_next_task(void) {
+#ifdef SCHEDULER_EDF
+    // the earliest due job first, tasks without a deadline get the rest
+    if (sched.edf_count != 0) {
+        return sched.edf_heap[0];
+    }
+#endif
+    
+#ifdef SCHEDULER_TASK_BITMAP
+    task_id_t next_task = bitmap_find(&sched.ready, sched_current_task + 1);
+    
+    // wrap around to the lowest ready id
+    if (next_task == NO_TASK) {
+        next_task = bitmap_find(&sched.ready, 0);
+    }
+    
+    return next_task;
+#else
+    task_id_t next_task = sched_current_task;
+    
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        next_task = (next_task + 1) % sched.task_count;
+        
+        if (sched.tasks[next_task].state == TASK_READY || 
+            sched.tasks[next_task].state == TASK_RUNNING) {
+            return next_task;
+        }
+    }
+    
+    return NO_TASK;
+#endif
+}
+
+// idle task - runs whenever every task is blocked or suspended
+// the tick isr counts the time spent here and wakes tasks up
+static task_id_t idle_task(void) {
+    task_id_t next_task;
+    
+    sched_idle_running = 1;
+    
+    while ((next_task = find_next_task()) == NO_TASK) {
+        // background work first, sleep only once the hook has none left
+        if (sched.idle_hook == NULL || !sched.idle_hook()) {
+            port_idle();
+        }
+        
+        // task states are updated by the tick isr
+        asm volatile ("" ::: "memory");
+    }
+    
+    sched_idle_running = 0;
+    
+    return next_task;
+}
+
+// set idle hook
+void scheduler_set_idle_hook(scheduler_idle_hook_t hook) {
+    sched.idle_hook = hook;
+}
+
+// check for a ready task
+uint8_t scheduler_task_ready(void) {
+    return find_next_task() != NO_TASK;
 }
 
 // voluntary yield
 void scheduler_yield(void) {
     // early return if no tasks
-    if (task_count == 0) {
+    if (sched.task_count == 0) {
         return;
     }
     
 #ifdef SCHEDULER_DEBUG
     // track voluntary yields
-    debug_stats.voluntary_yields++;
+    debug_count(&sched.debug_counters.voluntary_yields);
 #endif
     
     // find next ready task (round-robin)
-    uint8_t next_task = current_task;
-    uint8_t tasks_checked = 0;
+    task_id_t next_task = find_next_task();
     
-    do {
-        next_task = (next_task + 1) % task_count;
-        tasks_checked++;
-        
-        if (tasks[next_task].state == TASK_READY || 
-            tasks[next_task].state == TASK_RUNNING) {
-            break;
+    // nothing is ready - run the idle task until a delay expires
+    if (next_task == NO_TASK) {
+        if (!sched_running) {
+            return;
         }
-    } while (tasks_checked < task_count);
+        next_task = idle_task();
+    }
     
     // if we found a different task, perform context switch
-    if (next_task != current_task && tasks[next_task].state != TASK_BLOCKED) {
+    if (next_task != sched_current_task) {
 #ifdef SCHEDULER_DEBUG
-        debug_stats.context_switches++;
-        tasks[next_task].times_scheduled++;
+        debug_count(&sched.debug_counters.context_switches);
+        debug_count(&sched.tasks[next_task].times_scheduled);
 #endif
         
         // update task states
-        if (tasks[current_task].state == TASK_RUNNING) {
-            tasks[current_task].state = TASK_READY;
+        // ready and running tasks are both in the ready set, so these
+        // transitions do not need task_set_state()
+        if (sched.tasks[sched_current_task].state == TASK_RUNNING) {
+            sched.tasks[sched_current_task].state = TASK_READY;
         }
         
-        current_task = next_task;
-        tasks[current_task].state = TASK_RUNNING;
+        task_id_t prev_task = sched_current_task;
+        sched_current_task = next_task;
+        sched.tasks[sched_current_task].state = TASK_RUNNING;
         
-        // context switch happens here - but since we're cooperative,
-        // we just return and the calling function resumes
+        // save this task's context and resume the next one
+        // returns here when this task is scheduled again
+        if (sched_running) {
+            port_switch(&sched.tasks[prev_task], &sched.tasks[next_task]);
+        }
+    } else {
+        // the same task continues, e.g. after its delay expired in idle
+        sched.tasks[sched_current_task].state = TASK_RUNNING;
     }
 }
 
@@ -287,9 +1136,16 @@ void task_delay(uint16_t ticks) {
     uint8_t sreg = SREG;
     cli();
     
+    // ticks counted before this call must not shorten the new delay
+    delay_flush();
+    
     // set delay counter and block task
-    tasks[current_task].delay_ticks = ticks;
-    tasks[current_task].state = TASK_BLOCKED;
+    task_set_delay(sched_current_task, ticks);
+    task_set_state(sched_current_task, TASK_BLOCKED);
+    
+    if (sched.delay_due == 0 || ticks < sched.delay_due) {
+        sched.delay_due = ticks;
+    }
     
     // restore interrupts
     SREG = sreg;
@@ -299,53 +1155,310 @@ void task_delay(uint16_t ticks) {
 }
 
 // get current task id
-uint8_t scheduler_get_current_task(void) {
-    return current_task;
+task_id_t scheduler_get_current_task(void) {
+    return sched_current_task;
 }
 
 // get task count
-uint8_t scheduler_get_task_count(void) {
-    return task_count;
+task_id_t scheduler_get_task_count(void) {
+    return sched.task_count;
+}
+
+// get the free-running tick counter
+uint16_t scheduler_get_ticks(void) {
+    // two byte read, the tick isr writes it
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ticks = sched.ticks;
+    SREG = sreg;
+    
+    return ticks;
+}
+
+// check if the scheduler has been started
+uint8_t scheduler_is_running(void) {
+    return sched_running;
+}
+
+// get ticks until the next wakeup
+uint16_t scheduler_next_wakeup(void) {
+    uint16_t next = 0;
+    
+    // delay counters are updated by the tick isr
+    uint8_t sreg = SREG;
+    cli();
+    
+#ifdef SCHEDULER_TASK_BITMAP
+    for (task_id_t i = bitmap_find(&sched.sleeping, 0); i != NO_TASK;
+         i = bitmap_find(&sched.sleeping, i + 1)) {
+#else
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+#endif
+        // counted ticks are not yet taken off the delays
+        uint16_t delay = sched.tasks[i].delay_ticks - sched.delay_elapsed;
+        
+        if (sched.tasks[i].delay_ticks > 0 && sched.tasks[i].state == TASK_BLOCKED &&
+            (next == 0 || delay < next)) {
+            next = delay;
+        }
+    }
+    
+    SREG = sreg;
+    
+    return next;
+}
+
+// account for ticks the tick isr missed
+// the cpu slept through them, so they are all idle time
+void scheduler_skip_ticks(uint16_t ticks) {
+    if (!sched_running || ticks == 0) {
+        return;
+    }
+    
+    sched.ticks += ticks;
+    
+#ifdef SCHEDULER_STATS
+    sched.stats_sequence++;
+#endif
+    
+#ifdef SCHEDULER_DEBUG
+    if (sched.debug_reset_pending) {
+        debug_stats_clear_isr_counters();
+        sched.debug_reset_pending = 0;
+    }
+    
+    debug_count_add(&sched.debug_counters.total_ticks, ticks);
+#endif
+    
+#ifdef SCHEDULER_CPU_LOAD
+    sched.idle_ticks += ticks;
+    
+    // close every load window the skipped ticks complete
+    for (uint16_t left = ticks; left != 0; ) {
+        uint8_t step = SCHEDULER_LOAD_WINDOW - sched.load_window_ticks;
+        
+        if (left < step) {
+            step = (uint8_t)left;
+        }
+        sched.idle_window_ticks += step;
+        sched.load_window_ticks += step;
+        left -= step;
+        
+        if (sched.load_window_ticks >= SCHEDULER_LOAD_WINDOW) {
+            load_window_end();
+        }
+    }
+#endif
+    
+#ifdef SCHEDULER_STATS
+    sched.stats_sequence++;
+#endif
+    
+    // count the delays down one wakeup at a time, like the tick isr would
+    while (ticks != 0 && sched.delay_due != 0) {
+        uint16_t step = ticks < sched.delay_due ? ticks : sched.delay_due;
+        
+        ticks -= step;
+        sched.delay_due -= step;
+        
+        if (sched.delay_due == 0) {
+            // tick_wake() takes the last tick itself
+            sched.delay_elapsed += step - 1;
+            tick_wake();
+        } else {
+            sched.delay_elapsed += step;
+        }
+    }
+}
+
+// record time asleep
+void scheduler_count_sleep(uint8_t mode, uint16_t ticks) {
+    if (mode < SCHEDULER_SLEEP_MODES) {
+        sched.sleep_ticks[mode] += ticks;
+    }
 }
 
+// get time asleep
+uint32_t scheduler_get_sleep_ticks(uint8_t mode) {
+    uint32_t ticks = 0;
+    
+    if (mode < SCHEDULER_SLEEP_MODES) {
+        // written from the idle path with interrupts disabled
+        uint8_t sreg = SREG;
+        cli();
+        ticks = sched.sleep_ticks[mode];
+        SREG = sreg;
+    }
+    
+    return ticks;
+}
+
+#ifdef SCHEDULER_REENTRANT
+// allocate a new scheduler instance
+scheduler_t* scheduler_create(void) {
+    return calloc(1, sizeof(scheduler_t));
+}
+
+// free a scheduler instance
+void scheduler_destroy(scheduler_t *instance) {
+    if (instance == current_scheduler) {
+        current_scheduler = &default_scheduler;
+    }
+    free(instance);
+}
+
+// select the calling thread's scheduler instance
+void scheduler_set_instance(scheduler_t *instance) {
+    current_scheduler = (instance != NULL) ? instance : &default_scheduler;
+}
+#endif
+
+#ifdef SCHEDULER_CPU_LOAD
+// get total cpu utilisation
+void scheduler_get_cpu_load(scheduler_load_t *load) {
+    if (load == NULL) {
+        return;
+    }
+    
+    // the averages are updated by the tick isr
+    uint8_t sequence;
+    do {
+        sequence = stats_read_begin();
+        *load = sched.cpu_load;
+    } while (stats_read_retry(sequence));
+}
+
+// get task-specific cpu utilisation
+int8_t scheduler_get_task_load(task_id_t task_id, scheduler_load_t *load) {
+    if (task_id >= sched.task_count || load == NULL) {
+        return -1;
+    }
+    
+    uint8_t sequence;
+    do {
+        sequence = stats_read_begin();
+        *load = sched.tasks[task_id].load;
+    } while (stats_read_retry(sequence));
+    
+    return 0;
+}
+
+// get idle ticks
+uint32_t scheduler_get_idle_ticks(void) {
+    uint8_t sequence;
+    uint32_t ticks;
+    do {
+        sequence = stats_read_begin();
+        ticks = sched.idle_ticks;
+    } while (stats_read_retry(sequence));
+    
+    return ticks;
+}
+#endif
+
 #ifdef SCHEDULER_DEBUG
 // get debug statistics
 const scheduler_debug_t* scheduler_get_debug_stats(void) {
-    return (const scheduler_debug_t*)&debug_stats;
+    uint8_t sequence;
+    do {
+        sequence = stats_read_begin();
+        sched.debug_stats.total_ticks = debug_count_read(&sched.debug_counters.total_ticks);
+        sched.debug_stats.context_switches = debug_count_read(&sched.debug_counters.context_switches);
+        sched.debug_stats.voluntary_yields = debug_count_read(&sched.debug_counters.voluntary_yields);
+#ifdef SCHEDULER_EDF
+        sched.debug_stats.deadline_misses = debug_count_read(&sched.debug_counters.deadline_misses);
+#endif
+    } while (stats_read_retry(sequence));
+    
+    return &sched.debug_stats;
 }
 
 // get task-specific debug statistics
-int8_t scheduler_get_task_stats(uint8_t task_id, uint32_t *runtime_ticks, uint32_t *times_scheduled) {
-    if (task_id >= task_count) {
+int8_t scheduler_get_task_stats(task_id_t task_id, uint32_t *runtime_ticks, uint32_t *times_scheduled) {
+    if (task_id >= sched.task_count) {
         return -1;
     }
     
+    uint32_t runtime;
+    uint32_t scheduled;
+    uint8_t sequence;
+    do {
+        sequence = stats_read_begin();
+        runtime = debug_count_read(&sched.tasks[task_id].runtime_ticks);
+        scheduled = debug_count_read(&sched.tasks[task_id].times_scheduled);
+    } while (stats_read_retry(sequence));
+    
     if (runtime_ticks != NULL) {
-        *runtime_ticks = tasks[task_id].runtime_ticks;
+        *runtime_ticks = runtime;
     }
     
     if (times_scheduled != NULL) {
-        *times_scheduled = tasks[task_id].times_scheduled;
+        *times_scheduled = scheduled;
     }
     
     return 0;
 }
 
+// take a consistent copy of all debug counters without disabling interrupts
+void scheduler_get_debug_snapshot(scheduler_debug_snapshot_t *snapshot) {
+    if (snapshot == NULL) {
+        return;
+    }
+    
+    uint8_t sequence;
+    do {
+        sequence = stats_read_begin();
+        
+        snapshot->system.total_ticks = debug_count_read(&sched.debug_counters.total_ticks);
+        snapshot->system.context_switches = debug_count_read(&sched.debug_counters.context_switches);
+        snapshot->system.voluntary_yields = debug_count_read(&sched.debug_counters.voluntary_yields);
+#ifdef SCHEDULER_EDF
+        snapshot->system.deadline_misses = debug_count_read(&sched.debug_counters.deadline_misses);
+#endif
+        snapshot->task_count = sched.task_count;
+        
+        for (task_id_t i = 0; i < sched.task_count; i++) {
+            snapshot->runtime_ticks[i] = debug_count_read(&sched.tasks[i].runtime_ticks);
+            snapshot->times_scheduled[i] = debug_count_read(&sched.tasks[i].times_scheduled);
+#ifdef SCHEDULER_EDF
+            snapshot->deadline_misses[i] = debug_count_read(&sched.tasks[i].deadline_misses);
+#endif
+        }
+    } while (stats_read_retry(sequence));
+}
+
+// clear the counters owned by the tick isr
+static void debug_stats_clear_isr_counters(void) {
+    debug_count_clear(&sched.debug_counters.total_ticks);
+    
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        debug_count_clear(&sched.tasks[i].runtime_ticks);
+    }
+}
+
 // reset debug statistics
+// counters written from task context are cleared here, the ones written by
+// the tick isr are cleared by the isr itself on its next tick
 void scheduler_reset_debug_stats(void) {
-    uint8_t sreg = SREG;
-    cli();
-    
-    debug_stats.total_ticks = 0;
-    debug_stats.context_switches = 0;
-    debug_stats.voluntary_yields = 0;
+    debug_count_clear(&sched.debug_counters.context_switches);
+    debug_count_clear(&sched.debug_counters.voluntary_yields);
+#ifdef SCHEDULER_EDF
+    debug_count_clear(&sched.debug_counters.deadline_misses);
+#endif
     
-    for (uint8_t i = 0; i < task_count; i++) {
-        tasks[i].runtime_ticks = 0;
-        tasks[i].times_scheduled = 0;
+    for (task_id_t i = 0; i < sched.task_count; i++) {
+        debug_count_clear(&sched.tasks[i].times_scheduled);
+#ifdef SCHEDULER_EDF
+        debug_count_clear(&sched.tasks[i].deadline_misses);
+#endif
     }
     
-    SREG = sreg;
+    if (sched_running) {
+        sched.debug_reset_pending = 1;
+    } else {
+        // the tick isr does not touch the counters before the scheduler starts
+        debug_stats_clear_isr_counters();
+    }
 }
 
 // print debug statistics
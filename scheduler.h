@@ -4,14 +4,55 @@
 #include <stdint.h>
 #include <avr/io.h>
 
-// maximum number of tasks the scheduler can handle
+// maximum number of tasks the scheduler can handle (override with -D)
+#ifndef MAX_TASKS
 #define MAX_TASKS 8
+#endif
+
+#if MAX_TASKS > 256
+#error "MAX_TASKS must not exceed 256"
+#endif
+
+// task ids stay 8-bit unless scheduler_add_task() could not return them
+// in an int8_t, so the default build keeps its byte-sized fields
+#if MAX_TASKS > 127
+typedef uint16_t task_id_t;     // task id or count
+typedef int16_t task_sid_t;     // task id, or -1 on error
+#else
+typedef uint8_t task_id_t;
+typedef int8_t task_sid_t;
+#endif
 
-// default stack size for each task (in bytes)
+// default stack size for each task in bytes (override with -D)
+#ifndef TASK_STACK_SIZE
 #define TASK_STACK_SIZE 128
+#endif
+
+// number of TASK_STACK_SIZE stacks reserved for scheduler_add_task()
+// (override with -D), builds that only use SCHEDULER_TASK_DEFINE() can set 0
+#ifndef SCHEDULER_DYNAMIC_TASKS
+#define SCHEDULER_DYNAMIC_TASKS MAX_TASKS
+#endif
 
-// enable debug tracing (comment out to disable)
+// enable debug tracing (define SCHEDULER_NO_DEBUG to disable)
+#if !defined(SCHEDULER_DEBUG) && !defined(SCHEDULER_NO_DEBUG)
 #define SCHEDULER_DEBUG
+#endif
+
+// enable cpu load meter with idle task accounting
+// (define SCHEDULER_NO_CPU_LOAD to disable)
+#if !defined(SCHEDULER_CPU_LOAD) && !defined(SCHEDULER_NO_CPU_LOAD)
+#define SCHEDULER_CPU_LOAD
+#endif
+
+#ifdef SCHEDULER_CPU_LOAD
+// number of ticks per load sample, must fit in uint8_t
+// the moving average decay factors in scheduler.c are derived for 128
+#define SCHEDULER_LOAD_WINDOW 128
+
+// load values are unsigned q0.16 fractions (0 = 0%, 65535 = 100%)
+#define SCHEDULER_LOAD_TO_PERMILLE(load) ((uint16_t)(((uint32_t)(load) * 1000UL) >> 16))
+#endif
 
 // task states
 typedef enum {
@@ -21,16 +62,45 @@ typedef enum {
     TASK_SUSPENDED
 } task_state_t;
 
+#ifdef SCHEDULER_CPU_LOAD
+// cpu utilisation as exponential moving averages
+typedef struct {
+    uint16_t load_1s;           // 1 second average
+    uint16_t load_10s;          // 10 second average
+} scheduler_load_t;
+#endif
+
+#ifdef SCHEDULER_DEBUG
+// debug event counter kept as two 16-bit halves so the hot paths only do
+// 16-bit arithmetic, the upper half is touched only when the lower one wraps
+typedef struct {
+    uint16_t hot;               // lower 16 bits, incremented per event
+    uint16_t folded;            // upper 16 bits, incremented on wrap
+} debug_counter_t;
+#endif
+
 // task control block
 typedef struct {
     uint8_t *stack_pointer;     // current stack pointer
-    uint8_t stack[TASK_STACK_SIZE]; // task's stack
+    uint8_t *stack_top;         // last byte of the task's stack
     task_state_t state;         // current task state
-    uint8_t task_id;            // unique task identifier
+    task_id_t task_id;          // unique task identifier
     uint16_t delay_ticks;       // delay counter in system ticks
 #ifdef SCHEDULER_DEBUG
-    uint32_t runtime_ticks;     // total ticks this task has been running
-    uint32_t times_scheduled;   // number of times task was scheduled
+    debug_counter_t runtime_ticks;      // total ticks this task has been running
+    debug_counter_t times_scheduled;    // number of times task was scheduled
+#endif
+#ifdef SCHEDULER_CPU_LOAD
+    uint8_t load_window_ticks;  // ticks run in the current load window
+    scheduler_load_t load;      // cpu utilisation of this task
+#endif
+#ifdef SCHEDULER_EDF
+    uint16_t deadline;          // relative deadline in ticks, 0 = none
+    uint16_t deadline_at;       // tick by which the current job must block
+    task_id_t heap_index;       // position in the deadline heap
+#ifdef SCHEDULER_DEBUG
+    debug_counter_t deadline_misses;    // jobs that blocked after deadline_at
+#endif
 #endif
 } task_t;
 
@@ -40,27 +110,76 @@ typedef struct {
     uint32_t total_ticks;           // total system ticks since start
     uint32_t context_switches;      // total number of context switches
     uint32_t voluntary_yields;      // number of voluntary yields
+#ifdef SCHEDULER_EDF
+    uint32_t deadline_misses;       // jobs of all tasks that missed their deadline
+#endif
 } scheduler_debug_t;
+
+// consistent copy of all debug counters
+typedef struct {
+    scheduler_debug_t system;               // system-wide counters
+    task_id_t task_count;                   // number of valid per-task entries
+    uint32_t runtime_ticks[MAX_TASKS];      // per-task runtime ticks
+    uint32_t times_scheduled[MAX_TASKS];    // per-task schedule count
+#ifdef SCHEDULER_EDF
+    uint32_t deadline_misses[MAX_TASKS];    // per-task deadline misses
+#endif
+} scheduler_debug_snapshot_t;
 #endif
 
 // task function pointer type
 typedef void (*task_func_t)(void);
 
+// scheduler state (defined in scheduler.c)
+typedef struct scheduler scheduler_t;
+
+// static task descriptor, placed in flash by SCHEDULER_TASK_DEFINE()
+typedef struct {
+    task_func_t function;       // task entry point
+    uint8_t *stack_top;         // last byte of the task's stack
+    uint8_t priority;           // higher values get lower task ids
+} scheduler_task_def_t;
+
+// declare a task at compile time (file scope, name must be unique)
+// the stack is sized exactly and the descriptor lives in the flash section
+// scheduler_tasks (see tasks.ld), scheduler_init() adds every defined task
+// before any scheduler_add_task() call, in descending priority order
+// (equal priorities in table order), the scheduler itself stays round-robin
+// the explicit alignment keeps the compiler from padding the table
+// one byte per task in the non-loaded .taskcount section lets the linker
+// reject more tasks than MAX_TASKS
+#define SCHEDULER_TASK_DEFINE(name, fn, stack, prio) \
+    static uint8_t name##_task_stack[stack]; \
+    static const scheduler_task_def_t name##_task_def \
+        __attribute__((section("scheduler_tasks"), used, \
+                       aligned(__alignof__(scheduler_task_def_t)))) = { \
+            (fn), &name##_task_stack[(stack) - 1], (prio) \
+        }; \
+    static const uint8_t name##_task_count \
+        __attribute__((section(".taskcount"), used)) = 0
+
 // initialize the scheduler - must be called before any other scheduler functions
 void scheduler_init(void);
 
-// add a new task to the scheduler
-// returns task ID (0-255) on success, -1 on failure
-int8_t scheduler_add_task(task_func_t task_function);
+// add a new task to the scheduler, using one of SCHEDULER_DYNAMIC_TASKS stacks
+// returns task ID on success, -1 on failure
+task_sid_t scheduler_add_task(task_func_t task_function);
+
+// scheduler_start() only returns on the host port (see port_host.c)
+#ifdef HOST_TEST_BUILD
+#define SCHEDULER_NORETURN
+#else
+#define SCHEDULER_NORETURN __attribute__((noreturn))
+#endif
 
-// start the scheduler - this function never returns
-void scheduler_start(void) __attribute__((noreturn));
+// start the scheduler - this function never returns on avr
+void scheduler_start(void) SCHEDULER_NORETURN;
 
 // suspend a task
-void scheduler_suspend_task(uint8_t task_id);
+void scheduler_suspend_task(task_id_t task_id);
 
 // resume a suspended task
-void scheduler_resume_task(uint8_t task_id);
+void scheduler_resume_task(task_id_t task_id);
 
 // yield cpu to next task (voluntary context switch)
 void scheduler_yield(void);
@@ -70,21 +189,111 @@ void scheduler_yield(void);
 // ticks: number of system ticks to delay (1 tick = 1ms by default)
 void task_delay(uint16_t ticks);
 
+// block the current task until scheduler_wake_task() is called for it
+// call with interrupts disabled after checking the wait condition,
+// then restore interrupts and call scheduler_yield()
+void scheduler_block_current(void);
+
+// wake a task blocked by scheduler_block_current() (safe to call from isrs)
+void scheduler_wake_task(task_id_t task_id);
+
+// wake a blocked task, ending a task_delay() in progress early
+// (call from tasks, not from isrs)
+void scheduler_wake_early(task_id_t task_id);
+
+#ifdef SCHEDULER_EDF
+// earliest-deadline-first mode (-DSCHEDULER_EDF)
+// a task with a deadline releases a job whenever it becomes ready (its
+// delay ends, it is woken or resumed), due deadline ticks later; the job
+// ends when the task blocks again (task_delay(), scheduler_block_current())
+// at every yield the ready task with the earliest due job runs next, tasks
+// without a deadline run round-robin only while no deadline task is ready
+// switches still only happen at yields, so a job runs until it yields
+
+// set a task's relative deadline in ticks (at most 32767, 0 = none)
+// returns 0 on success, -1 on error
+int8_t scheduler_set_deadline(task_id_t task_id, uint16_t deadline);
+#endif
+
 // get the current running task id
-uint8_t scheduler_get_current_task(void);
+task_id_t scheduler_get_current_task(void);
 
 // get number of active tasks
-uint8_t scheduler_get_task_count(void);
+task_id_t scheduler_get_task_count(void);
+
+// get the number of ticks since scheduler_start(), wraps every 65536 ticks
+// compare tick values by their difference, e.g. (uint16_t)(now - then)
+uint16_t scheduler_get_ticks(void);
+
+// returns non-zero once scheduler_start() has been called
+uint8_t scheduler_is_running(void);
+
+// idle hook, called while no task is ready before the idle path sleeps
+// it runs on the stack of the task that yielded, keep it shallow
+// returns non-zero if it has more work: the scheduler then runs a task
+// that became ready or calls the hook again, instead of sleeping
+typedef uint8_t (*scheduler_idle_hook_t)(void);
+
+// set the idle hook (NULL to remove it), cleared by scheduler_init()
+void scheduler_set_idle_hook(scheduler_idle_hook_t hook);
+
+// returns non-zero if a task is ready to run, for idle hooks to stop early
+uint8_t scheduler_task_ready(void);
+
+// get number of ticks until the next delayed task wakes up
+// returns 0 if no task is waiting in task_delay()
+uint16_t scheduler_next_wakeup(void);
+
+#ifdef SCHEDULER_REENTRANT
+// reentrant build for host simulations: every thread drives its own
+// scheduler instance, all other functions act on the calling thread's one
+
+// allocate a zeroed instance, returns NULL if out of memory
+scheduler_t* scheduler_create(void);
+
+// free an instance that no thread uses anymore
+void scheduler_destroy(scheduler_t *instance);
+
+// select the instance used by the calling thread (NULL = default instance)
+void scheduler_set_instance(scheduler_t *instance);
+#endif
+
+// sleep modes of the idle path (see port_idle())
+// power-save is only used when built with -DSCHEDULER_SLEEP_POWER_SAVE
+#define SCHEDULER_SLEEP_MODE_IDLE       0   // cpu stopped, timer0 keeps ticking
+#define SCHEDULER_SLEEP_MODE_POWER_SAVE 1   // timer0 stopped, timer2 wakes the cpu
+#define SCHEDULER_SLEEP_MODES           2
+
+// get number of ticks spent sleeping in a sleep mode since init
+uint32_t scheduler_get_sleep_ticks(uint8_t mode);
+
+#ifdef SCHEDULER_CPU_LOAD
+// get total cpu utilisation (all time not spent in the idle task)
+void scheduler_get_cpu_load(scheduler_load_t *load);
+
+// get cpu utilisation of a specific task
+// returns 0 on success, -1 on error
+int8_t scheduler_get_task_load(task_id_t task_id, scheduler_load_t *load);
+
+// get number of ticks spent in the idle task since init
+uint32_t scheduler_get_idle_ticks(void);
+#endif
 
 #ifdef SCHEDULER_DEBUG
 // get debug statistics for the scheduler
+// returns a 32-bit copy of the counters that is refreshed on every call
 const scheduler_debug_t* scheduler_get_debug_stats(void);
 
 // get debug statistics for a specific task
 // returns 0 on success, -1 on error
-int8_t scheduler_get_task_stats(uint8_t task_id, uint32_t *runtime_ticks, uint32_t *times_scheduled);
+int8_t scheduler_get_task_stats(task_id_t task_id, uint32_t *runtime_ticks, uint32_t *times_scheduled);
+
+// copy all debug counters consistently without disabling interrupts
+// the snapshot is large, keep it off small task stacks
+void scheduler_get_debug_snapshot(scheduler_debug_snapshot_t *snapshot);
 
-// reset debug statistics
+// reset debug statistics without disabling interrupts
+// tick counters are cleared on the next tick once the scheduler is running
 void scheduler_reset_debug_stats(void);
 
 // print debug statistics to uart (if uart is initialized)
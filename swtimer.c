@@ -0,0 +1,129 @@
+#include "swtimer.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stddef.h>
+
+// running timers, sorted by expiry tick
+static swtimer_t *swtimer_head = NULL;
+
+// timer service task, -1 until the first swtimer_start()
+static task_sid_t swtimer_task_id = -1;
+
+// insert a timer into the expiry list, after timers due at the same tick
+static void swtimer_insert(swtimer_t *timer) {
+    swtimer_t **link = &swtimer_head;
+    
+    // expiry ticks wrap, compare them by their difference
+    while (*link != NULL && (int16_t)((*link)->expiry - timer->expiry) <= 0) {
+        link = &(*link)->next;
+    }
+    
+    timer->next = *link;
+    *link = timer;
+    timer->active = 1;
+}
+
+// take a timer out of the expiry list
+static void swtimer_remove(swtimer_t *timer) {
+    for (swtimer_t **link = &swtimer_head; *link != NULL; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+    }
+    
+    timer->next = NULL;
+    timer->active = 0;
+}
+
+// timer service task, runs the callbacks of due timers on its own stack
+static void swtimer_task(void) {
+    while (1) {
+        uint16_t now = scheduler_get_ticks();
+        
+        // run every timer due by now, earliest first
+        while (swtimer_head != NULL && (int16_t)(swtimer_head->expiry - now) <= 0) {
+            swtimer_t *timer = swtimer_head;
+            
+            // off the list before the callback, which may restart or stop it
+            swtimer_head = timer->next;
+            timer->next = NULL;
+            timer->active = 0;
+            
+            if (timer->period != 0) {
+                // from the previous expiry, so the period does not drift
+                timer->expiry += timer->period;
+                swtimer_insert(timer);
+            }
+            
+            timer->callback(timer);
+        }
+        
+        if (swtimer_head == NULL) {
+            // no timer running, swtimer_start() wakes this task again
+            uint8_t sreg = SREG;
+            cli();
+            scheduler_block_current();
+            SREG = sreg;
+            scheduler_yield();
+        } else {
+            int16_t left = (int16_t)(swtimer_head->expiry - scheduler_get_ticks());
+            
+            if (left > 0) {
+                // nothing to do before the earliest expiry
+                task_delay((uint16_t)left);
+            } else {
+                // callbacks ran past the next expiry, let other tasks run first
+                scheduler_yield();
+            }
+        }
+    }
+}
+
+// forget all timers
+void swtimer_init(void) {
+    swtimer_head = NULL;
+    swtimer_task_id = -1;
+}
+
+// start or restart a timer
+int8_t swtimer_start(swtimer_t *timer, swtimer_func_t callback,
+                     uint16_t delay, uint16_t period) {
+    if (timer == NULL || callback == NULL) {
+        return -1;
+    }
+    
+    if (swtimer_task_id < 0) {
+        swtimer_task_id = scheduler_add_task(swtimer_task);
+        if (swtimer_task_id < 0) {
+            return -1;
+        }
+    }
+    
+    if (timer->active) {
+        swtimer_remove(timer);
+    }
+    
+    timer->expiry = scheduler_get_ticks() + delay;
+    timer->period = period;
+    timer->callback = callback;
+    swtimer_insert(timer);
+    
+    // the service task may be sleeping until a later expiry
+    scheduler_wake_early((task_id_t)swtimer_task_id);
+    
+    return 0;
+}
+
+// stop a timer
+void swtimer_stop(swtimer_t *timer) {
+    if (timer != NULL && timer->active) {
+        // the service task wakes up for nothing at most once
+        swtimer_remove(timer);
+    }
+}
+
+// check whether a timer is running
+uint8_t swtimer_active(const swtimer_t *timer) {
+    return timer != NULL && timer->active;
+}
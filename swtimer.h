@@ -0,0 +1,49 @@
+#ifndef SWTIMER_H
+#define SWTIMER_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+// software timers
+// a timer calls its callback once after a delay (one-shot) or every
+// period ticks (auto-reload). all callbacks run one after another on the
+// stack of one shared timer service task, so a periodic activity costs a
+// swtimer_t instead of a task with a TASK_STACK_SIZE stack
+// running timers are kept sorted by expiry tick, the service task sleeps
+// in task_delay() until the first one is due
+//
+// callbacks must not block (task_delay(), uart_getc() ...), that would
+// delay every other timer. they may start and stop timers, themselves too
+
+struct swtimer;
+
+// timer callback, gets the timer that fired
+typedef void (*swtimer_func_t)(struct swtimer *timer);
+
+// timer state, embed it in a struct to give the callback parameters
+typedef struct swtimer {
+    uint16_t expiry;            // tick at which the timer fires next
+    uint16_t period;            // reload ticks, 0 = one-shot
+    uint8_t active;             // non-zero while in the expiry list
+    swtimer_func_t callback;    // called when the timer fires
+    struct swtimer *next;       // next timer to expire
+} swtimer_t;
+
+// forget all timers, call after scheduler_init()
+void swtimer_init(void);
+
+// start (or restart) a timer: callback runs delay ticks from now, then
+// every period ticks if period is not 0. delay and period at most 32767
+// the first call also adds the timer service task
+// call from main(), a task or a callback, not from an isr
+// returns 0 on success, -1 if the service task could not be added
+int8_t swtimer_start(swtimer_t *timer, swtimer_func_t callback,
+                     uint16_t delay, uint16_t period);
+
+// stop a timer, its callback will not run again until it is restarted
+void swtimer_stop(swtimer_t *timer);
+
+// returns non-zero if the timer is running
+uint8_t swtimer_active(const swtimer_t *timer);
+
+#endif // SWTIMER_H
@@ -5,15 +5,19 @@
 #ifndef _AVR_INTERRUPT_H_
 #define _AVR_INTERRUPT_H_
 
-// Mock interrupt control
-#define cli() do { } while(0)
-#define sei() do { } while(0)
+#include <avr/io.h>
+
+// Mock interrupt control, tracks the global interrupt flag in the mock SREG
+#define cli() do { SREG &= (uint8_t)~(1 << SREG_I); } while(0)
+#define sei() do { SREG |= (uint8_t)(1 << SREG_I); } while(0)
 
 // Mock ISR macro
 #define ISR(vector, ...) void vector(void)
 
 // Mock interrupt vectors
 #define TIMER0_COMPA_vect timer0_compare_isr
+#define USART_RX_vect usart_rx_isr
+#define USART_UDRE_vect usart_udre_isr
 
 #endif // _AVR_INTERRUPT_H_
 
@@ -12,7 +12,14 @@ extern uint8_t mock_TCCR0A;
 extern uint8_t mock_TCCR0B;
 extern uint8_t mock_OCR0A;
 extern uint8_t mock_TIMSK0;
+
+// one status register per thread in reentrant builds, where each thread
+// simulates its own cpu (cli() and sei() write it)
+#ifdef SCHEDULER_REENTRANT
+extern __thread uint8_t mock_SREG;
+#else
 extern uint8_t mock_SREG;
+#endif
 
 #define TCCR0A mock_TCCR0A
 #define TCCR0B mock_TCCR0B
@@ -20,11 +27,38 @@ extern uint8_t mock_SREG;
 #define TIMSK0 mock_TIMSK0
 #define SREG mock_SREG
 
+// Mock USART0 registers
+extern uint8_t mock_UBRR0H;
+extern uint8_t mock_UBRR0L;
+extern uint8_t mock_UCSR0A;
+extern uint8_t mock_UCSR0B;
+extern uint8_t mock_UCSR0C;
+extern uint8_t mock_UDR0;
+
+#define UBRR0H mock_UBRR0H
+#define UBRR0L mock_UBRR0L
+#define UCSR0A mock_UCSR0A
+#define UCSR0B mock_UCSR0B
+#define UCSR0C mock_UCSR0C
+#define UDR0 mock_UDR0
+
 // Mock register bit positions
+#define SREG_I 7
 #define WGM01  1
 #define CS01   1
 #define CS00   0
 #define OCIE0A 1
 
+#define RXC0   7
+#define TXC0   6
+#define UDRE0  5
+#define U2X0   1
+#define RXCIE0 7
+#define UDRIE0 5
+#define RXEN0  4
+#define TXEN0  3
+#define UCSZ01 2
+#define UCSZ00 1
+
 #endif // _AVR_IO_H_
 
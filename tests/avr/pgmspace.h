@@ -0,0 +1,14 @@
+/*
+ * Mock avr/pgmspace.h for host testing
+ */
+
+#ifndef _AVR_PGMSPACE_H_
+#define _AVR_PGMSPACE_H_
+
+#include <string.h>
+
+// flash and ram share one address space on the host
+#define PROGMEM
+#define memcpy_P(dest, src, len) memcpy((dest), (src), (len))
+
+#endif // _AVR_PGMSPACE_H_
@@ -0,0 +1,282 @@
+/*
+ * Cycle-count microbenchmarks for the scheduler primitives
+ *
+ * Built once per MAX_TASKS value and run under simavr (make bench-cycles).
+ * Timer1 runs at the cpu clock, so the difference of two TCNT1 reads is
+ * the exact number of cycles in between. The cost of the reads themselves
+ * is measured first and subtracted.
+ *
+ * Every sample starts right after a timer0 tick with the uart idle, so no
+ * other interrupt lands inside a measurement. Results are printed as
+ * "csv,<primitive>,<max_tasks>,<min>,<max>" lines.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "../scheduler.h"
+#include "../uart.h"
+
+#define BAUD 115200
+
+// samples per primitive
+#define SAMPLES 16
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+// measured cycle range of one primitive
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+} bench_range_t;
+
+// cross-task measurement: the driver stamps, the next task records
+static volatile uint16_t stamp = 0;
+static volatile uint8_t stamp_pending = 0;
+static volatile uint16_t stamp_cycles = 0;
+
+// helpers sleep in task_delay() instead of yielding while set
+static volatile uint8_t helpers_sleep = 0;
+
+// cycles spent reading TCNT1 twice
+static uint16_t overhead = 0;
+
+static void put_dec(uint16_t val) {
+    char buf[6];
+    uint8_t i = 0;
+    
+    do {
+        buf[i++] = '0' + (val % 10);
+        val /= 10;
+    } while (val > 0);
+    
+    while (i > 0) {
+        uart_putc(buf[--i]);
+    }
+}
+
+// print one csv result line
+static void bench_report(const char *name, const bench_range_t *range) {
+    uart_puts("csv,");
+    uart_puts(name);
+    uart_putc(',');
+    put_dec(MAX_TASKS);
+    uart_putc(',');
+    put_dec(range->min);
+    uart_putc(',');
+    put_dec(range->max);
+    uart_putc('\n');
+}
+
+// let pending uart output drain so its interrupts stay out of the samples
+static void bench_quiet(void) {
+    uart_flush();
+    task_delay(2);
+}
+
+// wait for the start of a tick period (the tick isr has just run)
+static void bench_sync(void) {
+    uint8_t last = TCNT0;
+    uint8_t now;
+    
+    while ((now = TCNT0) >= last) {
+        last = now;
+    }
+}
+
+static void bench_add_sample(bench_range_t *range, uint16_t cycles) {
+    if (cycles < range->min) {
+        range->min = cycles;
+    }
+    if (cycles > range->max) {
+        range->max = cycles;
+    }
+}
+
+// helper tasks record the stamp when they get the cpu
+static void helper_task(void) {
+    while (1) {
+        if (helpers_sleep) {
+            task_delay(1000);
+        } else {
+            scheduler_yield();
+        }
+        
+        uint16_t now = TCNT1;
+        if (stamp_pending) {
+            stamp_cycles = now - stamp - overhead;
+            stamp_pending = 0;
+        }
+    }
+}
+
+// yield from the driver until the next task returns from its own yield
+static void bench_switch(bench_range_t *range) {
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        bench_sync();
+        stamp_pending = 1;
+        stamp = TCNT1;
+        scheduler_yield();
+        bench_add_sample(range, stamp_cycles);
+    }
+}
+
+// task_delay() from the driver until the next task returns from its yield
+static void bench_task_delay(bench_range_t *range) {
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        bench_sync();
+        stamp_pending = 1;
+        stamp = TCNT1;
+        task_delay(1);
+        bench_add_sample(range, stamp_cycles);
+    }
+}
+
+// yield with every other task suspended (no switch)
+static void bench_yield_self(bench_range_t *range) {
+    for (uint8_t id = 1; id < scheduler_get_task_count(); id++) {
+        scheduler_suspend_task(id);
+    }
+    
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        bench_sync();
+        uint16_t start = TCNT1;
+        scheduler_yield();
+        uint16_t end = TCNT1;
+        bench_add_sample(range, end - start - overhead);
+    }
+    
+    for (uint8_t id = 1; id < scheduler_get_task_count(); id++) {
+        scheduler_resume_task(id);
+    }
+}
+
+// one tick isr including entry and reti, called through its vector
+static void bench_isr(bench_range_t *range) {
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        bench_sync();
+        cli();
+        uint16_t start = TCNT1;
+        asm volatile ("call " XSTR(TIMER0_COMPA_vect) ::: "memory");
+        cli();
+        uint16_t end = TCNT1;
+        sei();
+        bench_add_sample(range, end - start - overhead);
+    }
+}
+
+// the tick isr that ends the earliest delay, the worst-case tick: it
+// applies the ticks counted so far to every sleeping task and wakes them
+// all, as the helpers went to sleep together. the ticks before it are
+// delivered by hand (untimed), and the helpers go back to sleep between
+// samples
+static void bench_isr_wake(bench_range_t *range) {
+    for (uint8_t i = 0; i < SAMPLES; i++) {
+        // a real tick may land between two of these calls (reti enables
+        // interrupts), so check the countdown instead of counting calls
+        while (1) {
+            cli();
+            if (scheduler_next_wakeup() <= 1) {
+                break;
+            }
+            asm volatile ("call " XSTR(TIMER0_COMPA_vect) ::: "memory");
+        }
+        
+        uint16_t start = TCNT1;
+        asm volatile ("call " XSTR(TIMER0_COMPA_vect) ::: "memory");
+        cli();
+        uint16_t end = TCNT1;
+        sei();
+        bench_add_sample(range, end - start - overhead);
+        
+        // the woken helpers start their next delay
+        scheduler_yield();
+    }
+}
+
+// measurement driver, task 0
+static void bench_task(void) {
+    bench_range_t range;
+    
+    // let every helper reach its loop once
+    scheduler_yield();
+    
+    cli();
+    uint16_t start = TCNT1;
+    uint16_t end = TCNT1;
+    sei();
+    overhead = end - start;
+    
+    uart_puts("Cycle benchmark, MAX_TASKS=");
+    put_dec(MAX_TASKS);
+    uart_puts("\n");
+    
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_switch(&range);
+    bench_report("switch", &range);
+    
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_task_delay(&range);
+    bench_report("task_delay", &range);
+    
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_yield_self(&range);
+    bench_report("yield", &range);
+    
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_isr(&range);
+    bench_report("isr", &range);
+    
+    // every other task counts down a delay, the tick ends none of them
+    helpers_sleep = 1;
+    scheduler_yield();
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_isr(&range);
+    bench_report("isr_all_delayed", &range);
+    
+    // worst case tick: the one that ends the delays
+    bench_quiet();
+    range.min = 0xFFFF;
+    range.max = 0;
+    bench_isr_wake(&range);
+    bench_report("isr_wake", &range);
+    helpers_sleep = 0;
+    
+    uart_puts("*** BENCHMARK DONE ***\n");
+    
+    // sleeping with interrupts off ends the simavr run
+    uart_flush();
+    cli();
+    sleep_enable();
+    sleep_cpu();
+}
+
+int main(void) {
+    uart_init(BAUD);
+    
+    // timer1 free-running at the cpu clock
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+    
+    scheduler_init();
+    scheduler_add_task(bench_task);
+    
+    while (scheduler_add_task(helper_task) >= 0) {
+        // fill every task slot
+    }
+    
+    scheduler_start();
+    
+    return 0;
+}
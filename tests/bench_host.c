@@ -0,0 +1,276 @@
+/*
+ * Host throughput benchmark for the scheduler operations
+ *
+ * Built once per MAX_TASKS value (make bench-host) to expose paths that
+ * grow with the task count. Runs on the host port in virtual time, so no
+ * clock polling or tick delivery is mixed into the numbers. Every
+ * operation is repeated until at least BENCH_MIN_NS have elapsed.
+ *
+ * Output is one "<operation>,<max_tasks>,<ns_per_op>" line per operation.
+ * A host task switch is a swapcontext(), whose sigprocmask system call
+ * dominates "yield", so "yield" measures the port rather than the
+ * scheduler. "port_switch" is a bare swapcontext() and "yield_core" is the
+ * yield with it subtracted; it is a difference of two large numbers, so
+ * compare algorithms on it only across several runs. "yield_self" never
+ * switches and has no port cost.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <ucontext.h>
+
+// Define mock AVR registers used by the scheduler core
+uint8_t mock_TCCR0A = 0;
+uint8_t mock_TCCR0B = 0;
+uint8_t mock_OCR0A = 0;
+uint8_t mock_TIMSK0 = 0;
+uint8_t mock_SREG = 0;
+
+#include <avr/interrupt.h>
+#include "../scheduler.h"
+#include "../port.h"
+
+// minimum measuring time per operation
+#define BENCH_MIN_NS 20000000ULL
+
+// delay of the tasks that sleep through a measurement
+#define BENCH_LONG_DELAY 60000
+
+// tick interrupt handler from scheduler.c
+void TIMER0_COMPA_vect(void);
+
+// operations measured while the scheduler runs
+typedef enum {
+    OP_YIELD,       // yield switching to the next ready task
+    OP_YIELD_SELF,  // yield with every other task suspended
+    OP_ISR,         // tick isr with every task ready
+    OP_ISR_WAKE,    // tick isr ending a delay with every other task sleeping
+    OP_DELAY,       // task_delay(1) with every other task sleeping
+    OP_SUSPEND,
+    OP_RESUME,
+    OP_COUNT
+} bench_op_t;
+
+static const char *op_names[OP_COUNT] = {
+    "yield", "yield_self", "isr", "isr_wake", "delay", "suspend", "resume"
+};
+
+static double op_ns[OP_COUNT];
+
+// bare swapcontext(), measured right after the yields it is compared with
+static double switch_ns;
+
+// what the helper tasks do
+typedef enum {
+    HELPER_YIELD,       // pass the cpu on
+    HELPER_SLEEP,       // task 1 sleeps 1 tick, the others BENCH_LONG_DELAY
+    HELPER_SLEEP_LONG   // all sleep BENCH_LONG_DELAY
+} helper_mode_t;
+
+static volatile helper_mode_t helper_mode = HELPER_YIELD;
+
+// contexts for the bare swapcontext() baseline
+static ucontext_t baseline_main;
+static ucontext_t baseline_peer;
+static uint8_t baseline_stack[16384];
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// other tasks pass the cpu on or sleep, see helper_mode
+static void helper_task(void) {
+    while (1) {
+        if (helper_mode == HELPER_YIELD) {
+            scheduler_yield();
+        } else if (helper_mode == HELPER_SLEEP && scheduler_get_current_task() == 1) {
+            task_delay(1);
+        } else {
+            task_delay(BENCH_LONG_DELAY);
+        }
+    }
+}
+
+// switches straight back, the other half of the baseline
+static void baseline_task(void) {
+    while (1) {
+        swapcontext(&baseline_peer, &baseline_main);
+    }
+}
+
+// time of one bare swapcontext(), what the host port adds to every switch
+static double baseline_switch_ns(void) {
+    getcontext(&baseline_peer);
+    baseline_peer.uc_stack.ss_sp = baseline_stack;
+    baseline_peer.uc_stack.ss_size = sizeof(baseline_stack);
+    baseline_peer.uc_link = NULL;
+    makecontext(&baseline_peer, baseline_task, 0);
+    
+    uint64_t ops = 0;
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    
+    do {
+        for (uint16_t i = 0; i < 1000; i++) {
+            swapcontext(&baseline_main, &baseline_peer);
+        }
+        ops += 2000;
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    
+    return (double)elapsed / ops;
+}
+
+// measurement driver, task 0
+static void bench_task(void) {
+    task_id_t count = scheduler_get_task_count();
+    uint64_t ops;
+    uint64_t start;
+    uint64_t elapsed;
+    
+    // a full round passes through every task once
+    ops = 0;
+    start = now_ns();
+    do {
+        for (uint16_t i = 0; i < 1000; i++) {
+            scheduler_yield();
+        }
+        ops += 1000u * count;
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    op_ns[OP_YIELD] = (double)elapsed / ops;
+    switch_ns = baseline_switch_ns();
+    
+    for (task_id_t id = 1; id < count; id++) {
+        scheduler_suspend_task(id);
+    }
+    
+    ops = 0;
+    start = now_ns();
+    do {
+        for (uint16_t i = 0; i < 1000; i++) {
+            scheduler_yield();
+        }
+        ops += 1000;
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    op_ns[OP_YIELD_SELF] = (double)elapsed / ops;
+    
+    for (task_id_t id = 1; id < count; id++) {
+        scheduler_resume_task(id);
+    }
+    
+    ops = 0;
+    start = now_ns();
+    do {
+        for (uint16_t i = 0; i < 1000; i++) {
+            TIMER0_COMPA_vect();
+        }
+        ops += 1000;
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    op_ns[OP_ISR] = (double)elapsed / ops;
+    
+    // suspend and resume every other task, timed separately
+    uint64_t suspend_ns = 0;
+    uint64_t resume_ns = 0;
+    ops = 0;
+    do {
+        start = now_ns();
+        for (uint16_t i = 0; i < 100; i++) {
+            for (task_id_t id = 1; id < count; id++) {
+                scheduler_suspend_task(id);
+            }
+        }
+        suspend_ns += now_ns() - start;
+        
+        start = now_ns();
+        for (uint16_t i = 0; i < 100; i++) {
+            for (task_id_t id = 1; id < count; id++) {
+                scheduler_resume_task(id);
+            }
+        }
+        resume_ns += now_ns() - start;
+        
+        ops += 100u * (count - 1);
+    } while (suspend_ns + resume_ns < BENCH_MIN_NS);
+    op_ns[OP_SUSPEND] = (double)suspend_ns / ops;
+    op_ns[OP_RESUME] = (double)resume_ns / ops;
+    
+    // the other tasks go to sleep, task 1 for one tick at a time
+    helper_mode = HELPER_SLEEP;
+    scheduler_yield();
+    
+    // cost of reading the clock, taken off every single-tick sample
+    uint64_t clock_ns = now_ns();
+    for (uint16_t i = 0; i < 1000; i++) {
+        now_ns();
+    }
+    clock_ns = (now_ns() - clock_ns) / 1000;
+    
+    // each sample is one tick ending task 1's delay, which applies the
+    // elapsed ticks to every sleeper (the worst-case tick); the yield in
+    // between lets task 1 sleep again and is not timed
+    uint64_t wake_ns = 0;
+    ops = 0;
+    start = now_ns();
+    do {
+        scheduler_yield();
+        
+        uint64_t tick_start = now_ns();
+        TIMER0_COMPA_vect();
+        wake_ns += now_ns() - tick_start - clock_ns;
+        ops++;
+    } while (now_ns() - start < BENCH_MIN_NS);
+    op_ns[OP_ISR_WAKE] = (double)wake_ns / ops;
+    
+    // task 1 joins the long sleepers, then this task sleeps one tick at a
+    // time: delay bookkeeping, the idle wait and the wakeup tick
+    helper_mode = HELPER_SLEEP_LONG;
+    scheduler_yield();
+    task_delay(2);
+    
+    ops = 0;
+    start = now_ns();
+    do {
+        for (uint16_t i = 0; i < 1000; i++) {
+            task_delay(1);
+        }
+        ops += 1000;
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    op_ns[OP_DELAY] = (double)elapsed / ops;
+    
+    port_host_stop();
+}
+
+int main(void) {
+    uint64_t ops = 0;
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    
+    // adding a task includes building its host context
+    do {
+        scheduler_init();
+        while (scheduler_add_task(helper_task) >= 0) {
+            ops++;
+        }
+    } while ((elapsed = now_ns() - start) < BENCH_MIN_NS);
+    double add_ns = (double)elapsed / ops;
+    
+    scheduler_init();
+    scheduler_add_task(bench_task);
+    while (scheduler_add_task(helper_task) >= 0) {
+        // fill every task slot
+    }
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    
+    printf("add,%u,%.1f\n", MAX_TASKS, add_ns);
+    for (uint8_t op = 0; op < OP_COUNT; op++) {
+        printf("%s,%u,%.1f\n", op_names[op], MAX_TASKS, op_ns[op]);
+    }
+    printf("port_switch,%u,%.1f\n", MAX_TASKS, switch_ns);
+    printf("yield_core,%u,%.1f\n", MAX_TASKS, op_ns[OP_YIELD] - switch_ns);
+    
+    return 0;
+}
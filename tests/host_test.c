@@ -10,13 +10,30 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#ifdef SCHEDULER_REENTRANT
+#include <pthread.h>
+#endif
 
 // Define mock AVR registers (extern declarations are in avr/io.h)
 uint8_t mock_TCCR0A = 0;
 uint8_t mock_TCCR0B = 0;
 uint8_t mock_OCR0A = 0;
 uint8_t mock_TIMSK0 = 0;
+#ifdef SCHEDULER_REENTRANT
+__thread uint8_t mock_SREG = 0;
+#else
 uint8_t mock_SREG = 0;
+#endif
+uint8_t mock_UBRR0H = 0;
+uint8_t mock_UBRR0L = 0;
+uint8_t mock_UCSR0A = 0;
+uint8_t mock_UCSR0B = 0;
+uint8_t mock_UCSR0C = 0;
+uint8_t mock_UDR0 = 0;
+
+// USART interrupt handlers from uart.c
+void usart_rx_isr(void);
+void usart_udre_isr(void);
 
 // Enable debug mode
 #ifndef SCHEDULER_DEBUG
@@ -25,6 +42,13 @@ uint8_t mock_SREG = 0;
 
 // Now include scheduler
 #include "../scheduler.h"
+#include "../log.h"
+#include "../uart.h"
+#include "../port.h"
+#include "../pt.h"
+#include "../swtimer.h"
+#include "../workq.h"
+#include "../bgjob.h"
 
 // Test framework
 static int tests_run = 0;
@@ -107,6 +131,91 @@ void test_task_2(void) {
     }
 }
 
+// Stops the scheduler once both checksum tasks are done (or gives up)
+void stopper_task(void) {
+    const uint32_t expected1 = 5u * 0xDEADBEEFu;
+    const uint32_t expected2 = 5u * 0xCAFEBABEu;
+    
+    for (int i = 0; i < 1000; i++) {
+        if (task1_checksum == expected1 && task2_checksum == expected2) {
+            break;
+        }
+        scheduler_yield();
+    }
+    
+    port_host_stop();
+}
+
+// Sleeps once and records how many ticks the delay took
+static volatile uint32_t delay_start_tick = 0;
+static volatile uint32_t delay_end_tick = 0;
+
+void delay_task(void) {
+    delay_start_tick = scheduler_get_debug_stats()->total_ticks;
+    task_delay(20);
+    delay_end_tick = scheduler_get_debug_stats()->total_ticks;
+    port_host_stop();
+}
+
+// Long-period task like the pwm motor example (5 s between steps)
+static volatile uint32_t slow_steps = 0;
+static volatile uint32_t fast_steps = 0;
+
+void slow_task(void) {
+    while (1) {
+        slow_steps++;
+        task_delay(5000);
+    }
+}
+
+void fast_task(void) {
+    while (1) {
+        fast_steps++;
+        task_delay(50);
+    }
+}
+
+// Periodic worker that consumes 3 ticks of cpu every 10 ticks
+static volatile uint32_t worker_runs = 0;
+static volatile uint32_t worker_last_start = 0;
+
+void worker_task(void) {
+    while (1) {
+        worker_runs++;
+        worker_last_start = port_host_get_ticks();
+        port_host_advance(3);
+        task_delay(7);
+    }
+}
+
+// Records the order in which tasks get the cpu
+#define ORDER_LOG_SIZE 96
+static task_id_t order_log[ORDER_LOG_SIZE];
+static volatile uint16_t order_count = 0;
+
+void order_task(void) {
+    while (1) {
+        if (order_count >= ORDER_LOG_SIZE) {
+            port_host_stop();
+        }
+        order_log[order_count++] = scheduler_get_current_task();
+        scheduler_yield();
+    }
+}
+
+// Sleeps for (task id + 1) ticks once, then blocks forever
+static uint32_t wake_tick[MAX_TASKS];
+
+void sleeper_task(void) {
+    task_id_t id = scheduler_get_current_task();
+    
+    task_delay(id + 1);
+    wake_tick[id] = port_host_get_ticks();
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
 void simple_task(void) {
     task1_run_count++;
 }
@@ -272,6 +381,145 @@ TEST(test_get_task_stats) {
     
     TEST_PASS();
 }
+
+TEST(test_debug_snapshot) {
+    static scheduler_debug_snapshot_t snapshot;
+    
+    scheduler_init();
+    
+    scheduler_add_task(simple_task);
+    scheduler_add_task(simple_task);
+    
+    // two yields, each switching to the other task
+    scheduler_yield();
+    scheduler_yield();
+    
+    memset(&snapshot, 0xAA, sizeof(snapshot));
+    scheduler_get_debug_snapshot(&snapshot);
+    
+    ASSERT_EQ(snapshot.task_count, 2, "Snapshot should cover 2 tasks");
+    ASSERT_EQ(snapshot.system.total_ticks, 0, "No ticks before start");
+    ASSERT_EQ(snapshot.system.voluntary_yields, 2, "Snapshot should count 2 yields");
+    ASSERT_EQ(snapshot.system.context_switches, 2, "Snapshot should count 2 switches");
+    ASSERT_EQ(snapshot.times_scheduled[0] + snapshot.times_scheduled[1], 2,
+              "Per-task schedule counts should match switches");
+    ASSERT_EQ(snapshot.runtime_ticks[0], 0, "Runtime should be 0 before start");
+    
+    // reset before start clears everything immediately
+    scheduler_reset_debug_stats();
+    scheduler_get_debug_snapshot(&snapshot);
+    ASSERT_EQ(snapshot.system.voluntary_yields, 0, "Yields should be 0 after reset");
+    ASSERT_EQ(snapshot.system.context_switches, 0, "Switches should be 0 after reset");
+    ASSERT_EQ(snapshot.times_scheduled[1], 0, "Task stats should be 0 after reset");
+    
+    TEST_PASS();
+}
+
+TEST(test_debug_counter_wrap) {
+    scheduler_init();
+    
+    scheduler_add_task(simple_task);
+    scheduler_add_task(simple_task);
+    
+    // push the 16-bit hot counters past their wrap point
+    for (uint32_t i = 0; i < 70000UL; i++) {
+        scheduler_yield();
+    }
+    
+    const scheduler_debug_t *stats = scheduler_get_debug_stats();
+    ASSERT(stats->voluntary_yields == 70000UL, "Yields should carry past 16 bits");
+    ASSERT(stats->context_switches == 70000UL, "Switches should carry past 16 bits");
+    
+    uint32_t scheduled = 0;
+    scheduler_get_task_stats(0, NULL, &scheduled);
+    ASSERT(scheduled == 35000UL, "Task 0 should be scheduled every other yield");
+    
+    TEST_PASS();
+}
+#endif
+
+#ifdef SCHEDULER_CPU_LOAD
+TEST(test_cpu_load_initialization) {
+    scheduler_init();
+    
+    int8_t task_id = scheduler_add_task(simple_task);
+    ASSERT(task_id >= 0, "Task should be added");
+    
+    scheduler_load_t load = {0xFFFF, 0xFFFF};
+    scheduler_get_cpu_load(&load);
+    ASSERT_EQ(load.load_1s, 0, "1s load should be 0 after init");
+    ASSERT_EQ(load.load_10s, 0, "10s load should be 0 after init");
+    ASSERT_EQ(scheduler_get_idle_ticks(), 0, "Idle ticks should be 0 after init");
+    
+    load.load_1s = 0xFFFF;
+    int8_t result = scheduler_get_task_load(task_id, &load);
+    ASSERT_EQ(result, 0, "Getting task load should succeed");
+    ASSERT_EQ(load.load_1s, 0, "Task load should be 0 initially");
+    
+    result = scheduler_get_task_load(255, &load);
+    ASSERT(result < 0, "Getting load for invalid task should fail");
+    
+    ASSERT_EQ(SCHEDULER_LOAD_TO_PERMILLE(0xFFFF), 999, "Full load should be ~1000 permille");
+    ASSERT_EQ(SCHEDULER_LOAD_TO_PERMILLE(0x8000), 500, "Half load should be 500 permille");
+    
+    TEST_PASS();
+}
+
+// Runs 3 of every 10 ticks for about 4 time constants of the 10 s average,
+// then sleeps for 20 load windows so both averages decay
+#define LOAD_BUSY_TICKS 40000UL
+#define LOAD_REST_TICKS (20 * SCHEDULER_LOAD_WINDOW)
+
+static scheduler_load_t load_busy_cpu, load_busy_task;
+static scheduler_load_t load_rest_cpu, load_rest_task;
+
+void load_worker_task(void) {
+    task_id_t id = scheduler_get_current_task();
+    
+    while (port_host_get_ticks() < LOAD_BUSY_TICKS) {
+        port_host_advance(3);
+        task_delay(7);
+    }
+    
+    scheduler_get_cpu_load(&load_busy_cpu);
+    scheduler_get_task_load(id, &load_busy_task);
+    
+    task_delay(LOAD_REST_TICKS);
+    
+    scheduler_get_cpu_load(&load_rest_cpu);
+    scheduler_get_task_load(id, &load_rest_task);
+    port_host_stop();
+}
+
+TEST(test_cpu_load_tracks_workload) {
+    scheduler_init();
+    scheduler_add_task(load_worker_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    uint16_t cpu_1s = SCHEDULER_LOAD_TO_PERMILLE(load_busy_cpu.load_1s);
+    uint16_t cpu_10s = SCHEDULER_LOAD_TO_PERMILLE(load_busy_cpu.load_10s);
+    uint16_t task_1s = SCHEDULER_LOAD_TO_PERMILLE(load_busy_task.load_1s);
+    uint16_t task_10s = SCHEDULER_LOAD_TO_PERMILLE(load_busy_task.load_10s);
+    
+    ASSERT(cpu_1s >= 290 && cpu_1s <= 310, "1s cpu load should settle near 300 permille");
+    ASSERT(cpu_10s >= 280 && cpu_10s <= 310, "10s cpu load should settle near 300 permille");
+    ASSERT(task_1s >= 290 && task_1s <= 310, "1s task load should settle near 300 permille");
+    ASSERT(task_10s >= 280 && task_10s <= 310, "10s task load should settle near 300 permille");
+    
+    // 20 idle windows: the 1 s average falls to about 8%, the 10 s one to 77%
+    uint16_t rest_1s = SCHEDULER_LOAD_TO_PERMILLE(load_rest_cpu.load_1s);
+    uint16_t rest_10s = SCHEDULER_LOAD_TO_PERMILLE(load_rest_cpu.load_10s);
+    
+    ASSERT(rest_1s < 40, "1s cpu load should decay while idle");
+    ASSERT(rest_10s > 200 && rest_10s < 250, "10s cpu load should decay more slowly");
+    ASSERT(load_rest_task.load_1s <= load_rest_cpu.load_1s, "Sleeping task load should decay");
+    ASSERT(load_rest_task.load_10s < load_busy_task.load_10s, "Sleeping task load should decay");
+    
+    TEST_PASS();
+}
 #endif
 
 TEST(test_scheduler_yield_no_tasks) {
@@ -324,6 +572,901 @@ TEST(test_multiple_scheduler_init) {
     TEST_PASS();
 }
 
+TEST(test_log_record_layout) {
+    log_init();
+    
+    uint16_t value = 0x1234;
+    ASSERT_EQ(log_write(0x0102, &value, sizeof(value)), 0, "Log write should succeed");
+    
+    uint8_t buf[16];
+    uint8_t len = log_read(buf, sizeof(buf));
+    ASSERT_EQ(len, LOG_HEADER_SIZE + 2, "Record should be header plus 2 bytes");
+    ASSERT_EQ(buf[0], LOG_SYNC, "Record should start with sync byte");
+    ASSERT_EQ(buf[1], 0x02, "Id low byte");
+    ASSERT_EQ(buf[2], 0x01, "Id high byte");
+    ASSERT_EQ(buf[3], 2, "Argument length");
+    ASSERT_EQ(buf[4], 0x34, "Argument low byte");
+    ASSERT_EQ(buf[5], 0x12, "Argument high byte");
+    ASSERT_EQ(log_read(buf, sizeof(buf)), 0, "Ring should be empty after read");
+    
+    // macro form packs arguments back to back
+    uint8_t small = 7;
+    uint32_t big = 0xA0B0C0D0;
+    LOG2("small=%hhu big=%lx", small, big);
+    len = log_read(buf, sizeof(buf));
+    ASSERT_EQ(len, LOG_HEADER_SIZE + 5, "Record should carry 5 argument bytes");
+    ASSERT_EQ(buf[4], 7, "First argument byte");
+    ASSERT_EQ(buf[5], 0xD0, "Second argument starts after the first");
+    
+    TEST_PASS();
+}
+
+TEST(test_log_ring_full) {
+    log_init();
+    
+    uint32_t args[2] = {0, 0};
+    uint8_t record = LOG_HEADER_SIZE + sizeof(args);
+    uint8_t fits = LOG_BUFFER_SIZE / record;
+    
+    for (uint8_t i = 0; i < fits; i++) {
+        ASSERT_EQ(log_write(i, args, sizeof(args)), 0, "Record should fit");
+    }
+    
+    ASSERT(log_write(0xFF, args, sizeof(args)) < 0, "Write into full ring should fail");
+    ASSERT(log_write(0xFF, args, LOG_MAX_ARGS + 1) < 0, "Oversized record should fail");
+    ASSERT_EQ(log_get_dropped(), 2, "Both failed writes should be counted");
+    
+    // draining frees space again, bytes come out in order
+    uint8_t byte = 0;
+    ASSERT_EQ(log_read(&byte, 1), 1, "Should read one byte");
+    ASSERT_EQ(byte, LOG_SYNC, "Oldest byte is the first sync");
+    
+    uint8_t buf[LOG_BUFFER_SIZE];
+    uint8_t rest = log_read(buf, sizeof(buf));
+    ASSERT_EQ(rest, fits * record - 1, "Remaining bytes should be drained");
+    ASSERT_EQ(log_write(0, args, sizeof(args)), 0, "Write should succeed after drain");
+    
+    TEST_PASS();
+}
+
+TEST(test_uart_interrupt_tx) {
+    scheduler_init();
+    uart_init(115200);
+    
+    ASSERT_EQ(UBRR0L, 16, "UBRR should be 16 for 115200 baud double speed");
+    ASSERT(!(UCSR0B & (1 << UDRIE0)), "UDRE interrupt should be off when idle");
+    
+    uart_puts("ab\n");
+    ASSERT(UCSR0B & (1 << UDRIE0), "Queued data should enable UDRE interrupt");
+    
+    const char expected[] = "ab\r\n";
+    for (uint8_t i = 0; i < 4; i++) {
+        usart_udre_isr();
+        ASSERT_EQ(UDR0, expected[i], "UDRE isr should send bytes in order");
+    }
+    
+    usart_udre_isr();
+    ASSERT(!(UCSR0B & (1 << UDRIE0)), "Empty buffer should disable UDRE interrupt");
+    
+    TEST_PASS();
+}
+
+TEST(test_uart_write_before_start) {
+    scheduler_init();
+    uart_init(9600);
+    
+    // more than the buffer holds: the writer polls the hardware instead
+    // of blocking while the scheduler is not running
+    UCSR0A = (1 << UDRE0);
+    uint8_t data[UART_TX_BUFFER_SIZE + 10];
+    memset(data, 'x', sizeof(data));
+    uart_write(data, sizeof(data));
+    
+    uart_flush();
+    ASSERT_EQ(UDR0, 'x', "Polled bytes should reach the data register");
+    
+    usart_udre_isr();
+    ASSERT(!(UCSR0B & (1 << UDRIE0)), "Flushed buffer should disable UDRE interrupt");
+    
+    UCSR0A = 0;
+    
+    TEST_PASS();
+}
+
+TEST(test_uart_idle_busy) {
+    scheduler_init();
+    uart_init(9600);
+    
+    ASSERT(!uart_idle_busy(), "Idle uart should allow power-save");
+    
+    uart_putc('x');
+    ASSERT(uart_idle_busy(), "Queued byte should veto power-save");
+    
+    // the byte moves to the hardware, then the empty ring stops udre
+    usart_udre_isr();
+    usart_udre_isr();
+    UCSR0A &= ~(1 << TXC0);
+    ASSERT(uart_idle_busy(), "Byte in the shift register should veto power-save");
+    
+    UCSR0A |= (1 << TXC0);
+    ASSERT(!uart_idle_busy(), "Sent byte should allow power-save");
+    
+    TEST_PASS();
+}
+
+TEST(test_uart_rx) {
+    scheduler_init();
+    uart_init(9600);
+    
+    ASSERT_EQ(uart_available(), 0, "No rx data after init");
+    
+    UDR0 = 'h';
+    usart_rx_isr();
+    UDR0 = 'i';
+    usart_rx_isr();
+    ASSERT_EQ(uart_available(), 2, "Two bytes should be buffered");
+    
+    uint8_t buf[4];
+    ASSERT_EQ(uart_read(buf, sizeof(buf)), 2, "Read should return buffered bytes");
+    ASSERT_EQ(buf[0], 'h', "First byte");
+    ASSERT_EQ(buf[1], 'i', "Second byte");
+    
+    // overflow drops the newest bytes
+    for (uint8_t i = 0; i < UART_RX_BUFFER_SIZE + 5; i++) {
+        UDR0 = i;
+        usart_rx_isr();
+    }
+    ASSERT_EQ(uart_available(), UART_RX_BUFFER_SIZE, "Rx buffer should be full");
+    ASSERT_EQ(uart_getc(), 0, "Oldest byte should be kept");
+    
+    TEST_PASS();
+}
+
+TEST(test_host_port_context_switch) {
+    scheduler_init();
+    task1_run_count = 0;
+    task2_run_count = 0;
+    task1_checksum = 0;
+    task2_checksum = 0;
+    
+    scheduler_add_task(test_task_1);
+    scheduler_add_task(test_task_2);
+    scheduler_add_task(stopper_task);
+    
+    // runs the tasks on their own stacks until stopper_task stops it
+    scheduler_start();
+    
+    ASSERT_EQ(task1_run_count, 1, "Task 1 should have started once");
+    ASSERT_EQ(task2_run_count, 1, "Task 2 should have started once");
+    ASSERT(task1_checksum == 5u * 0xDEADBEEFu, "Task 1 locals should survive switches");
+    ASSERT(task2_checksum == 5u * 0xCAFEBABEu, "Task 2 locals should survive switches");
+    ASSERT(scheduler_get_debug_stats()->context_switches >= 10,
+           "Tasks should have alternated");
+    
+    TEST_PASS();
+}
+
+TEST(test_host_port_task_delay) {
+    scheduler_init();
+    delay_start_tick = 0;
+    delay_end_tick = 0;
+    
+    scheduler_add_task(delay_task);
+    scheduler_start();
+    
+    ASSERT(delay_end_tick - delay_start_tick >= 20, "Delay should last at least 20 ticks");
+#ifdef SCHEDULER_CPU_LOAD
+    ASSERT(scheduler_get_idle_ticks() >= 19, "Blocked time should be spent idle");
+#endif
+    
+    TEST_PASS();
+}
+
+TEST(test_virtual_time_fast_forward) {
+    scheduler_init();
+    slow_steps = 0;
+    fast_steps = 0;
+    
+    scheduler_add_task(slow_task);
+    scheduler_add_task(fast_task);
+    
+    // one hour of scheduled behaviour
+    port_host_set_virtual_time(1);
+    port_host_set_tick_limit(3600000UL);
+    scheduler_start();
+    port_host_set_tick_limit(0);
+    port_host_set_virtual_time(0);
+    
+    ASSERT(port_host_get_ticks() == 3600000UL, "Run should stop at the tick limit");
+    ASSERT_EQ(slow_steps, 720, "Slow task should step every 5000 ticks");
+    ASSERT_EQ(fast_steps, 72000, "Fast task should step every 50 ticks");
+    ASSERT(!port_host_deadlocked(), "Run should not deadlock");
+    
+    TEST_PASS();
+}
+
+TEST(test_virtual_time_deterministic) {
+    uint32_t runtime[2] = {0, 0};
+    uint32_t last_start[2] = {0, 0};
+    
+    for (int run = 0; run < 2; run++) {
+        scheduler_init();
+        worker_runs = 0;
+        worker_last_start = 0;
+        
+        scheduler_add_task(worker_task);
+        
+        port_host_set_virtual_time(1);
+        port_host_set_tick_limit(1000);
+        scheduler_start();
+        port_host_set_tick_limit(0);
+        port_host_set_virtual_time(0);
+        
+        scheduler_get_task_stats(0, &runtime[run], NULL);
+        last_start[run] = worker_last_start;
+        
+        ASSERT_EQ(worker_runs, 100, "Worker should run every 10 ticks");
+    }
+    
+    ASSERT_EQ(last_start[0], 990, "Last activation should start at tick 990");
+    ASSERT_EQ(runtime[0], 300, "Worker should be charged 3 ticks per run");
+    ASSERT_EQ(runtime[1], runtime[0], "Runs should be reproducible");
+    ASSERT_EQ(last_start[1], last_start[0], "Runs should be reproducible");
+    
+    TEST_PASS();
+}
+
+TEST(test_virtual_time_deadlock) {
+    scheduler_init();
+    
+    // a task blocked forever leaves nothing to wake up
+    scheduler_add_task(empty_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT(port_host_deadlocked(), "Run should stop when no task can wake up");
+    
+    TEST_PASS();
+}
+
+#ifdef SCHEDULER_REENTRANT
+// Independent simulation run by each thread of the reentrant test
+#define SIM_THREADS 4
+
+static __thread uint32_t sim_runs = 0;
+static __thread uint16_t sim_period = 0;
+
+void sim_task(void) {
+    while (1) {
+        sim_runs++;
+        port_host_advance(1);
+        task_delay(sim_period - 1);
+    }
+}
+
+typedef struct {
+    uint16_t period;
+    uint32_t runs;
+    uint32_t runtime;
+} sim_result_t;
+
+static void *sim_thread(void *arg) {
+    sim_result_t *result = arg;
+    scheduler_t *instance = scheduler_create();
+    
+    if (instance == NULL) {
+        return NULL;
+    }
+    
+    scheduler_set_instance(instance);
+    scheduler_init();
+    sim_runs = 0;
+    sim_period = result->period;
+    scheduler_add_task(sim_task);
+    scheduler_add_task(empty_task);
+    
+    port_host_set_virtual_time(1);
+    port_host_set_tick_limit(10000);
+    scheduler_start();
+    
+    result->runs = sim_runs;
+    scheduler_get_task_stats(0, &result->runtime, NULL);
+    
+    scheduler_set_instance(NULL);
+    scheduler_destroy(instance);
+    return NULL;
+}
+
+TEST(test_reentrant_parallel_schedulers) {
+    pthread_t threads[SIM_THREADS];
+    sim_result_t results[SIM_THREADS];
+    
+    // default instance state must survive the parallel runs
+    scheduler_init();
+    scheduler_add_task(simple_task);
+    
+    for (int i = 0; i < SIM_THREADS; i++) {
+        results[i].period = (uint16_t)(10 * (i + 1));
+        results[i].runs = 0;
+        results[i].runtime = 0;
+        ASSERT(pthread_create(&threads[i], NULL, sim_thread, &results[i]) == 0,
+               "Simulation thread should start");
+    }
+    
+    for (int i = 0; i < SIM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    for (int i = 0; i < SIM_THREADS; i++) {
+        ASSERT_EQ(results[i].runs, (10000u + results[i].period - 1) / results[i].period,
+                  "Each instance should keep its own period");
+        ASSERT_EQ(results[i].runtime, results[i].runs,
+                  "Each instance should keep its own statistics");
+    }
+    
+    ASSERT_EQ(scheduler_get_task_count(), 1, "Default instance should be untouched");
+    ASSERT(!scheduler_is_running(), "Default instance should not be running");
+    
+    TEST_PASS();
+}
+#endif
+
+TEST(test_round_robin_order) {
+    scheduler_init();
+    order_count = 0;
+    
+    for (int i = 0; i < MAX_TASKS; i++) {
+        scheduler_add_task(order_task);
+    }
+    
+    // leave gaps so the search has to skip suspended tasks
+    for (task_id_t id = 1; id < MAX_TASKS; id += 3) {
+        scheduler_suspend_task(id);
+    }
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(order_count, ORDER_LOG_SIZE, "Every task should have run");
+    ASSERT_EQ(order_log[0], 0, "Task 0 should run first");
+    
+    for (uint16_t i = 1; i < ORDER_LOG_SIZE; i++) {
+        // next non-suspended id after the previous one, wrapping around
+        task_id_t expected = order_log[i - 1];
+        do {
+            expected = (expected + 1) % MAX_TASKS;
+        } while (expected % 3 == 1);
+        
+        ASSERT_EQ(order_log[i], expected, "Tasks should run in round-robin order");
+    }
+    
+    TEST_PASS();
+}
+
+TEST(test_delay_wakeup_order) {
+    scheduler_init();
+    memset(wake_tick, 0, sizeof(wake_tick));
+    
+    for (int i = 0; i < MAX_TASKS; i++) {
+        scheduler_add_task(sleeper_task);
+    }
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT(port_host_deadlocked(), "Run should end once every task is blocked");
+    
+    for (int i = 0; i < MAX_TASKS; i++) {
+        ASSERT_EQ(wake_tick[i], (uint32_t)(i + 1), "Each task should wake after its delay");
+    }
+    
+    TEST_PASS();
+}
+
+// delays started at different ticks: long sleeps 30 ticks while short
+// sleeps 10 and then 5, so the earliest wakeup changes under a running delay
+static uint32_t stagger_ticks[3];
+static uint16_t stagger_next_wakeup = 0;
+
+void stagger_long_task(void) {
+    task_delay(30);
+    stagger_ticks[0] = port_host_get_ticks();
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
+void stagger_short_task(void) {
+    task_delay(10);
+    stagger_ticks[1] = port_host_get_ticks();
+    stagger_next_wakeup = scheduler_next_wakeup();
+    
+    task_delay(5);
+    stagger_ticks[2] = port_host_get_ticks();
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
+TEST(test_delay_staggered) {
+    scheduler_init();
+    memset(stagger_ticks, 0, sizeof(stagger_ticks));
+    
+    scheduler_add_task(stagger_long_task);
+    scheduler_add_task(stagger_short_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(stagger_ticks[1], 10, "Short delay should end first");
+    ASSERT_EQ(stagger_next_wakeup, 20, "Long delay should have 20 ticks left");
+    ASSERT_EQ(stagger_ticks[2], 15, "Second delay should count from its start");
+    ASSERT_EQ(stagger_ticks[0], 30, "Long delay should not be shortened");
+    
+    TEST_PASS();
+}
+
+// stackless tasks: a delays three times, c yields three times, b waits for c
+static pt_t pt_a, pt_b, pt_c;
+static uint16_t pt_a_ticks[3];
+static uint8_t pt_a_runs = 0;
+static uint8_t pt_c_yields = 0;
+static uint16_t pt_b_done_tick = 0;
+static char pt_order[8];
+static uint8_t pt_order_count = 0;
+
+static void pt_mark(char name) {
+    if (pt_order_count < sizeof(pt_order)) {
+        pt_order[pt_order_count++] = name;
+    }
+}
+
+static uint8_t pt_a_func(pt_t *pt) {
+    PT_BEGIN(pt);
+    
+    while (pt_a_runs < 3) {
+        PT_DELAY(pt, 10);
+        pt_a_ticks[pt_a_runs++] = scheduler_get_ticks();
+    }
+    
+    PT_END(pt);
+}
+
+static uint8_t pt_b_func(pt_t *pt) {
+    PT_BEGIN(pt);
+    
+    PT_WAIT_UNTIL(pt, pt_c_yields == 3);
+    pt_mark('b');
+    pt_b_done_tick = scheduler_get_ticks();
+    
+    PT_END(pt);
+}
+
+static uint8_t pt_c_func(pt_t *pt) {
+    PT_BEGIN(pt);
+    
+    while (pt_c_yields < 3) {
+        pt_mark('c');
+        pt_c_yields++;
+        PT_YIELD(pt);
+    }
+    
+    PT_END(pt);
+}
+
+// full-stack task interleaved with the pt tasks
+static void pt_peer_task(void) {
+    for (int i = 0; i < 3; i++) {
+        pt_mark('f');
+        scheduler_yield();
+    }
+    
+    task_delay(100);
+    port_host_stop();
+}
+
+TEST(test_stackless_tasks) {
+    scheduler_init();
+    pt_init();
+    pt_a_runs = 0;
+    pt_c_yields = 0;
+    pt_b_done_tick = 0xFFFF;
+    pt_order_count = 0;
+    
+    scheduler_add_task(pt_peer_task);
+    ASSERT_EQ(pt_add(&pt_a, pt_a_func), 0, "First pt task should add the shared task");
+    ASSERT_EQ(pt_add(&pt_b, pt_b_func), 0, "Second pt task should be added");
+    ASSERT_EQ(pt_add(&pt_c, pt_c_func), 0, "Third pt task should be added");
+    ASSERT_EQ(pt_add(&pt_c, NULL), -1, "Null function should be rejected");
+    ASSERT_EQ(scheduler_get_task_count(), 2, "All pt tasks should share one task");
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT(!port_host_deadlocked(), "Run should end through the peer task");
+    
+    // one pass of the pt tasks per turn of the full-stack task
+    ASSERT_EQ(pt_order_count, 7, "Every yield and wakeup should be seen");
+    ASSERT(memcmp(pt_order, "fcfcfcb", 7) == 0, "pt passes should alternate with the peer");
+    ASSERT_EQ(pt_b_done_tick, 0, "Waiting pt task should resume without a tick");
+    
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(pt_a_ticks[i], 10 * (i + 1), "PT_DELAY should wait like task_delay");
+    }
+    
+    ASSERT_EQ(pt_a.status, PT_EXITED, "Delaying pt task should finish");
+    ASSERT_EQ(pt_b.status, PT_EXITED, "Waiting pt task should finish");
+    ASSERT_EQ(pt_c.status, PT_EXITED, "Yielding pt task should finish");
+    
+    TEST_PASS();
+}
+
+// software timers: p fires every 10 ticks three times, a one-shot a is
+// stopped before it fires, b is started while the service task sleeps
+// until p is due and restarts itself once from its callback
+static swtimer_t swt_p, swt_a, swt_b;
+static uint16_t swt_p_ticks[4];
+static uint16_t swt_b_ticks[3];
+static uint8_t swt_p_count = 0;
+static uint8_t swt_b_count = 0;
+static uint8_t swt_a_fired = 0;
+
+static void swt_p_func(swtimer_t *timer) {
+    if (swt_p_count < 4) {
+        swt_p_ticks[swt_p_count] = scheduler_get_ticks();
+    }
+    if (++swt_p_count == 3) {
+        swtimer_stop(timer);
+    }
+}
+
+static void swt_a_func(swtimer_t *timer) {
+    (void)timer;
+    swt_a_fired = 1;
+}
+
+static void swt_b_func(swtimer_t *timer) {
+    if (swt_b_count < 3) {
+        swt_b_ticks[swt_b_count] = scheduler_get_ticks();
+    }
+    if (++swt_b_count == 1) {
+        swtimer_stop(&swt_a);
+        swtimer_start(timer, swt_b_func, 4, 0);
+    }
+}
+
+static void swt_peer_task(void) {
+    task_delay(5);
+    swtimer_start(&swt_b, swt_b_func, 2, 0);
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
+TEST(test_software_timers) {
+    scheduler_init();
+    swtimer_init();
+    swt_p_count = 0;
+    swt_b_count = 0;
+    swt_a_fired = 0;
+    
+    scheduler_add_task(swt_peer_task);
+    ASSERT_EQ(swtimer_start(&swt_p, swt_p_func, 10, 10), 0, "First timer should add the service task");
+    ASSERT_EQ(swtimer_start(&swt_a, swt_a_func, 100, 0), 0, "Second timer should be started");
+    ASSERT_EQ(swtimer_start(&swt_a, NULL, 100, 0), -1, "Null callback should be rejected");
+    ASSERT_EQ(scheduler_get_task_count(), 2, "All timers should share one task");
+    ASSERT(swtimer_active(&swt_a), "Started timer should be active");
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT(port_host_deadlocked(), "Run should end once no timer is running");
+    
+    ASSERT_EQ(swt_p_count, 3, "Stopped periodic timer should not fire again");
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(swt_p_ticks[i], 10 * (i + 1), "Periodic timer should fire every period");
+    }
+    
+    ASSERT_EQ(swt_b_count, 2, "Restarted one-shot timer should fire twice");
+    ASSERT_EQ(swt_b_ticks[0], 7, "Earlier timer should wake the sleeping service task");
+    ASSERT_EQ(swt_b_ticks[1], 11, "Timer restarted from its callback should fire again");
+    
+    ASSERT(!swt_a_fired, "Stopped timer should not fire");
+    ASSERT(!swtimer_active(&swt_a), "Stopped timer should be inactive");
+    ASSERT(!swtimer_active(&swt_p), "Stopped periodic timer should be inactive");
+    
+    TEST_PASS();
+}
+
+// deferred work: the queue is filled before the start, the worker drains
+// it in one batch, then a post from the poster task wakes it again
+static uint8_t work_log[WORKQ_SIZE + 2];
+static uint8_t work_count = 0;
+static uint8_t work_seen[2];
+
+static void work_record(void *arg) {
+    if (work_count < sizeof(work_log)) {
+        work_log[work_count++] = (uint8_t)(uintptr_t)arg;
+    }
+}
+
+static void work_poster_task(void) {
+    work_seen[0] = work_count;
+    workq_post(work_record, (void *)(uintptr_t)WORKQ_SIZE);
+    scheduler_yield();
+    
+    work_seen[1] = work_count;
+    port_host_stop();
+}
+
+TEST(test_work_queue) {
+    scheduler_init();
+    ASSERT_EQ(workq_init(), 0, "Init should add the worker task");
+    work_count = 0;
+    
+    for (int i = 0; i < WORKQ_SIZE; i++) {
+        ASSERT_EQ(workq_post(work_record, (void *)(uintptr_t)i), 0, "Post should fit");
+    }
+    ASSERT_EQ(workq_post(work_record, NULL), -1, "Post to a full queue should fail");
+    ASSERT_EQ(workq_post(NULL, NULL), -1, "Null function should be rejected");
+    ASSERT_EQ(workq_get_dropped(), 1, "Full queue should count the dropped post");
+    
+    scheduler_add_task(work_poster_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(work_seen[0], WORKQ_SIZE, "Worker should drain the queue in one batch");
+    ASSERT_EQ(work_seen[1], WORKQ_SIZE + 1, "Post should wake the idle worker");
+    
+    for (int i = 0; i <= WORKQ_SIZE; i++) {
+        ASSERT_EQ(work_log[i], i, "Work should run in posting order");
+    }
+    
+    TEST_PASS();
+}
+
+// uart readers: two tasks block on the empty rx buffer, both must be woken
+static uint8_t uart_reader_bytes[2];
+static uint8_t uart_readers_done = 0;
+static uint8_t uart_readers_busy = 0;
+
+static void uart_reader_task(void) {
+    uint8_t byte = uart_getc();
+    
+    uart_reader_bytes[uart_readers_done++] = byte;
+}
+
+static void uart_feeder_task(void) {
+    // let both readers block first
+    scheduler_yield();
+    uart_readers_busy = uart_idle_busy();
+    
+    UDR0 = 'a';
+    usart_rx_isr();
+    scheduler_yield();
+    UDR0 = 'b';
+    usart_rx_isr();
+    
+    for (int i = 0; i < 10 && uart_readers_done < 2; i++) {
+        scheduler_yield();
+    }
+    
+    port_host_stop();
+}
+
+TEST(test_uart_multiple_readers) {
+    scheduler_init();
+    uart_init(9600);
+    uart_readers_done = 0;
+    
+    scheduler_add_task(uart_reader_task);
+    scheduler_add_task(uart_reader_task);
+    scheduler_add_task(uart_feeder_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT(uart_readers_busy, "Waiting readers should veto power-save");
+    ASSERT_EQ(uart_readers_done, 2, "Both blocked readers should be woken");
+    ASSERT(!uart_idle_busy(), "No reader should be left waiting");
+    ASSERT_EQ(uart_reader_bytes[0], 'a', "First reader should get the first byte");
+    ASSERT_EQ(uart_reader_bytes[1], 'b', "Second reader should get the second byte");
+    
+    TEST_PASS();
+}
+
+// background jobs: a needs three chunks, c uses up its budget in one
+// chunk, both run while the only task sleeps and before time jumps ahead
+static bgjob_t job_a, job_c;
+static uint8_t job_a_chunks = 0;
+static uint32_t job_c_ticks = 0;
+static char job_order[8];
+static uint8_t job_order_count = 0;
+static uint32_t job_done_tick = 0;
+static uint32_t job_task_wake_tick = 0;
+
+static void job_mark(char name) {
+    if (job_order_count < sizeof(job_order)) {
+        job_order[job_order_count++] = name;
+    }
+}
+
+static uint8_t job_a_func(bgjob_t *job) {
+    (void)job;
+    job_mark('a');
+    
+    if (++job_a_chunks < 3) {
+        return BGJOB_MORE;
+    }
+    job_done_tick = port_host_get_ticks();
+    return BGJOB_DONE;
+}
+
+static uint8_t job_c_func(bgjob_t *job) {
+    (void)job;
+    job_mark('c');
+    
+    uint32_t start = port_host_get_ticks();
+    while (!bgjob_expired()) {
+        port_host_advance(1);
+    }
+    job_c_ticks = port_host_get_ticks() - start;
+    
+    return BGJOB_DONE;
+}
+
+static void job_sleeper_task(void) {
+    task_delay(10);
+    job_task_wake_tick = port_host_get_ticks();
+    port_host_stop();
+}
+
+TEST(test_background_jobs) {
+    scheduler_init();
+    bgjob_init();
+    job_a_chunks = 0;
+    job_order_count = 0;
+    
+    scheduler_add_task(job_sleeper_task);
+    ASSERT_EQ(bgjob_add(&job_a, job_a_func), 0, "First job should be queued");
+    ASSERT_EQ(bgjob_add(&job_c, job_c_func), 0, "Second job should be queued");
+    ASSERT_EQ(bgjob_add(&job_c, job_c_func), -1, "Queued job should not be added twice");
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(job_order_count, 4, "Every chunk should run once");
+    ASSERT(memcmp(job_order, "acaa", 4) == 0, "Jobs should take turns by chunk");
+    ASSERT_EQ(job_c_ticks, BGJOB_BUDGET, "Chunk should stop at its budget");
+    ASSERT_EQ(job_done_tick, BGJOB_BUDGET, "Jobs should run before the idle path sleeps");
+    ASSERT_EQ(job_task_wake_tick, 10, "Jobs should not delay the sleeping task");
+    ASSERT(!job_a.queued && !job_c.queued, "Finished jobs should leave the queue");
+    
+    TEST_PASS();
+}
+
+// ticks skipped while timer0 was stopped (power-save): the sleeper's delay
+// must end in the skipped ticks, later idle time counts as idle-mode sleep
+static uint16_t skip_next_wakeup = 0;
+static uint16_t skip_wake_ticks = 0;
+static uint16_t skip_end_ticks = 0;
+static uint8_t skip_sreg = 0;
+
+static void skip_sleeper_task(void) {
+    task_delay(10);
+    skip_wake_ticks = scheduler_get_ticks();
+    
+    task_delay(5);
+    skip_end_ticks = scheduler_get_ticks();
+    port_host_stop();
+}
+
+static void skip_sleep_task(void) {
+    // as port_idle() would after a power-save sleep
+    scheduler_skip_ticks(4);
+    skip_next_wakeup = scheduler_next_wakeup();
+    
+    // port_idle() calls it with interrupts disabled, waking the sleeper
+    // must not enable them
+    SREG = 0;
+    scheduler_skip_ticks(15);
+    skip_sreg = SREG;
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
+TEST(test_skip_ticks_and_sleep_stats) {
+    scheduler_init();
+    
+    scheduler_add_task(skip_sleeper_task);
+    scheduler_add_task(skip_sleep_task);
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(skip_next_wakeup, 6, "Skipped ticks should count the delay down");
+    ASSERT_EQ(skip_wake_ticks, 19, "Delay ending in skipped ticks should wake the task");
+    ASSERT(!(skip_sreg & (1 << SREG_I)), "Skipping ticks should leave interrupts disabled");
+    ASSERT_EQ(skip_end_ticks, 24, "Idle time should follow the skipped ticks");
+    ASSERT_EQ(scheduler_get_sleep_ticks(SCHEDULER_SLEEP_MODE_IDLE), 5, "Idle wait should count as idle sleep");
+    ASSERT_EQ(scheduler_get_sleep_ticks(SCHEDULER_SLEEP_MODE_POWER_SAVE), 0, "Host port never uses power-save");
+    ASSERT_EQ(scheduler_get_sleep_ticks(SCHEDULER_SLEEP_MODES), 0, "Unknown mode should read 0");
+    
+    TEST_PASS();
+}
+
+#ifdef SCHEDULER_EDF
+// earliest deadline first: a, b and c are released together with
+// deadlines 30, 5 and 8 and run 5 ticks each, d has no deadline
+static char edf_order[8];
+static uint8_t edf_order_count = 0;
+static scheduler_debug_snapshot_t edf_snapshot;
+
+static void edf_job(char name) {
+    if (edf_order_count < sizeof(edf_order)) {
+        edf_order[edf_order_count++] = name;
+    }
+    port_host_advance(5);
+    
+    scheduler_block_current();
+    scheduler_yield();
+}
+
+static void edf_a_task(void) { edf_job('a'); }
+static void edf_b_task(void) { edf_job('b'); }
+static void edf_c_task(void) { edf_job('c'); }
+
+static void edf_d_task(void) {
+    edf_order[edf_order_count++] = 'd';
+    port_host_stop();
+}
+
+TEST(test_edf_order_and_misses) {
+    scheduler_init();
+    edf_order_count = 0;
+    
+    task_id_t a = scheduler_add_task(edf_a_task);
+    task_id_t b = scheduler_add_task(edf_b_task);
+    task_id_t c = scheduler_add_task(edf_c_task);
+    scheduler_add_task(edf_d_task);
+    
+    ASSERT_EQ(scheduler_set_deadline(a, 30), 0, "Deadline should be set");
+    ASSERT_EQ(scheduler_set_deadline(b, 5), 0, "Deadline should be set");
+    ASSERT_EQ(scheduler_set_deadline(c, 8), 0, "Deadline should be set");
+    ASSERT_EQ(scheduler_set_deadline(c, 0x8000), -1, "Deadline beyond half the tick range should be rejected");
+    ASSERT_EQ(scheduler_set_deadline(MAX_TASKS - 1, 8), -1, "Unused task id should be rejected");
+    
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    ASSERT_EQ(edf_order_count, 4, "Every task should run once");
+    ASSERT(memcmp(edf_order, "bcad", 4) == 0, "Earliest deadline should run first, no deadline last");
+    
+    // c blocks at tick 10, two ticks after its deadline
+    scheduler_get_debug_snapshot(&edf_snapshot);
+    ASSERT_EQ(edf_snapshot.system.deadline_misses, 1, "One job should miss its deadline");
+    ASSERT_EQ(edf_snapshot.deadline_misses[c], 1, "The late job should be counted for its task");
+    ASSERT_EQ(edf_snapshot.deadline_misses[a] + edf_snapshot.deadline_misses[b], 0,
+              "Jobs blocking in time should not count");
+    
+    TEST_PASS();
+}
+#endif
+
 // ============================================================================
 // Main test runner
 // ============================================================================
@@ -352,6 +1495,41 @@ int main(void) {
     RUN_TEST(test_debug_stats_initialization);
     RUN_TEST(test_debug_stats_reset);
     RUN_TEST(test_get_task_stats);
+    RUN_TEST(test_debug_snapshot);
+    RUN_TEST(test_debug_counter_wrap);
+#endif
+    
+#ifdef SCHEDULER_CPU_LOAD
+    RUN_TEST(test_cpu_load_initialization);
+    RUN_TEST(test_cpu_load_tracks_workload);
+#endif
+    
+    RUN_TEST(test_log_record_layout);
+    RUN_TEST(test_log_ring_full);
+    RUN_TEST(test_uart_interrupt_tx);
+    RUN_TEST(test_uart_write_before_start);
+    RUN_TEST(test_uart_idle_busy);
+    RUN_TEST(test_uart_rx);
+    RUN_TEST(test_host_port_context_switch);
+    RUN_TEST(test_host_port_task_delay);
+    RUN_TEST(test_virtual_time_fast_forward);
+    RUN_TEST(test_virtual_time_deterministic);
+    RUN_TEST(test_virtual_time_deadlock);
+    RUN_TEST(test_round_robin_order);
+    RUN_TEST(test_delay_wakeup_order);
+    RUN_TEST(test_delay_staggered);
+    RUN_TEST(test_stackless_tasks);
+    RUN_TEST(test_software_timers);
+    RUN_TEST(test_work_queue);
+    RUN_TEST(test_uart_multiple_readers);
+    RUN_TEST(test_background_jobs);
+    RUN_TEST(test_skip_ticks_and_sleep_stats);
+#ifdef SCHEDULER_EDF
+    RUN_TEST(test_edf_order_and_misses);
+#endif
+    
+#ifdef SCHEDULER_REENTRANT
+    RUN_TEST(test_reentrant_parallel_schedulers);
 #endif
     
     // Print summary
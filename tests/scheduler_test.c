@@ -7,13 +7,14 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
 #include <string.h>
 #include "../scheduler.h"
+#include "../uart.h"
 
 // UART configuration for test output
 #define BAUD 9600
-#define MYUBRR F_CPU/16/BAUD-1
 
 // Test result tracking
 static uint16_t tests_run = 0;
@@ -34,27 +35,7 @@ static volatile uint16_t task2_stack_canary = 0;
 #define STACK_CANARY_1 0xA5A5
 #define STACK_CANARY_2 0x5A5A
 
-// UART functions
-void uart_init(void) {
-    uint16_t ubrr = MYUBRR;
-    UBRR0H = (uint8_t)(ubrr >> 8);
-    UBRR0L = (uint8_t)ubrr;
-    UCSR0B = (1 << TXEN0);  // Enable transmitter
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);  // 8-bit data
-}
-
-void uart_putc(char c) {
-    while (!(UCSR0A & (1 << UDRE0)));
-    UDR0 = c;
-}
-
-void uart_puts(const char *s) {
-    while (*s) {
-        if (*s == '\n') uart_putc('\r');
-        uart_putc(*s++);
-    }
-}
-
+// UART output helpers (uart_putc/uart_puts come from the uart driver)
 void uart_put_hex(uint16_t val) {
     const char hex[] = "0123456789ABCDEF";
     uart_putc('0'); uart_putc('x');
@@ -355,6 +336,14 @@ void monitor_task(void) {
         uart_puts("Tasks did not complete expected iterations!\n");
     }
     
+#ifdef TEST_EXIT_WHEN_DONE
+    // simulator build: sleeping with interrupts off ends the simavr run
+    uart_flush();
+    cli();
+    sleep_enable();
+    sleep_cpu();
+#endif
+    
     // Blink LED to signal completion
     DDRB |= (1 << PB5);  // Set LED pin as output
     while (1) {
@@ -366,7 +355,7 @@ void monitor_task(void) {
 // Main test runner
 int main(void) {
     // Initialize UART for test output
-    uart_init();
+    uart_init(BAUD);
     
     uart_puts("\n\n");
     uart_puts("===================================\n");
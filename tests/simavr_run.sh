@@ -0,0 +1,57 @@
+#!/bin/sh
+# Run an AVR ELF headless under simavr and check its UART output
+#
+# usage: simavr_run.sh MCU F_CPU ELF [TIMEOUT_SECONDS]
+#
+# The firmware ends the run by sleeping with interrupts disabled. UART
+# output is printed without simavr's colour codes. The exit status is
+# non-zero if the run times out, prints "TEST FAILED" or never prints
+# the success line ($SIM_PASS, default "ALL TESTS PASSED").
+
+SIMAVR=${SIMAVR:-simavr}
+SIM_PASS=${SIM_PASS:-ALL TESTS PASSED}
+
+if [ $# -lt 3 ]; then
+    echo "usage: $0 MCU F_CPU ELF [TIMEOUT_SECONDS]" >&2
+    exit 2
+fi
+
+mcu=$1
+freq=$(echo "$2" | sed 's/[UuLl]*$//')
+elf=$3
+limit=${4:-60}
+log=${elf%.elf}.log
+
+if ! command -v "$SIMAVR" >/dev/null 2>&1; then
+    echo "simavr_run: '$SIMAVR' not found (set SIMAVR=/path/to/run_avr)" >&2
+    exit 2
+fi
+
+timeout "$limit" "$SIMAVR" -m "$mcu" -f "$freq" "$elf" > "$log.raw" 2>&1
+status=$?
+sed 's/\x1b\[[0-9;]*m//g' "$log.raw" > "$log"
+rm -f "$log.raw"
+
+cat "$log"
+
+if [ $status -eq 124 ]; then
+    echo "simavr_run: $elf did not finish within ${limit}s" >&2
+    exit 1
+fi
+
+if [ $status -ne 0 ]; then
+    echo "simavr_run: simavr exited with status $status" >&2
+    exit 1
+fi
+
+if grep -q "TEST FAILED" "$log"; then
+    echo "simavr_run: $elf reported a failure" >&2
+    exit 1
+fi
+
+if ! grep -q "$SIM_PASS" "$log"; then
+    echo "simavr_run: $elf did not report success" >&2
+    exit 1
+fi
+
+exit 0
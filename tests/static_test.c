@@ -0,0 +1,169 @@
+/*
+ * Host-based tests for the static task table (SCHEDULER_TASK_DEFINE)
+ *
+ * Kept out of host_test.c because every scheduler_init() in this binary
+ * adds the tasks defined below. Built with SCHEDULER_DYNAMIC_TASKS=1, so
+ * only one task can be added at runtime on top of the table.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Define mock AVR registers (extern declarations are in avr/io.h)
+uint8_t mock_TCCR0A = 0;
+uint8_t mock_TCCR0B = 0;
+uint8_t mock_OCR0A = 0;
+uint8_t mock_TIMSK0 = 0;
+uint8_t mock_SREG = 0;
+
+#include "../scheduler.h"
+#include "../port.h"
+
+// Test framework
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) \
+    static void name(void); \
+    static void name##_wrapper(void) { \
+        printf("Running test: %s ... ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+    } \
+    static void name(void)
+
+#define ASSERT_EQ(actual, expected, message) \
+    do { \
+        if ((actual) != (expected)) { \
+            printf("FAIL\n  %s\n  Expected: %d, Got: %d\n  at %s:%d\n", \
+                   message, (int)(expected), (int)(actual), __FILE__, __LINE__); \
+            tests_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define TEST_PASS() \
+    do { \
+        printf("PASS\n"); \
+        tests_passed++; \
+    } while(0)
+
+#define RUN_TEST(test) test##_wrapper()
+
+// order in which the tasks first got the cpu
+#define ORDER_LOG_SIZE 8
+static char order_log[ORDER_LOG_SIZE];
+static uint8_t order_count = 0;
+
+static void order_mark(char name) {
+    if (order_count < ORDER_LOG_SIZE) {
+        order_log[order_count++] = name;
+    }
+}
+
+static void low_task(void) {
+    order_mark('l');
+    while (1) {
+        scheduler_yield();
+    }
+}
+
+static void high_task(void) {
+    order_mark('h');
+    while (1) {
+        scheduler_yield();
+    }
+}
+
+static void mid_a_task(void) {
+    order_mark('a');
+    while (1) {
+        scheduler_yield();
+    }
+}
+
+static void mid_b_task(void) {
+    order_mark('b');
+    while (1) {
+        scheduler_yield();
+    }
+}
+
+// last task of the round ends the run
+static void dynamic_task(void) {
+    order_mark('d');
+    port_host_stop();
+}
+
+// defined out of priority order on purpose
+SCHEDULER_TASK_DEFINE(low, low_task, 64, 0);
+SCHEDULER_TASK_DEFINE(mid_a, mid_a_task, 64, 5);
+SCHEDULER_TASK_DEFINE(high, high_task, 96, 9);
+SCHEDULER_TASK_DEFINE(mid_b, mid_b_task, 64, 5);
+
+TEST(test_static_table_loaded) {
+    scheduler_init();
+    ASSERT_EQ(scheduler_get_task_count(), 4, "Init should add every defined task");
+    
+    // a second init starts from the table again
+    scheduler_init();
+    ASSERT_EQ(scheduler_get_task_count(), 4, "Re-init should not duplicate tasks");
+    
+    TEST_PASS();
+}
+
+TEST(test_static_priority_order) {
+    scheduler_init();
+    ASSERT_EQ(scheduler_add_task(dynamic_task), 4, "Dynamic tasks follow the table");
+    
+    order_count = 0;
+    port_host_set_virtual_time(1);
+    scheduler_start();
+    port_host_set_virtual_time(0);
+    
+    // equal priorities follow the table, whose order is up to the toolchain
+    ASSERT_EQ(order_count, 5, "Every task should run once");
+    ASSERT_EQ(order_log[0], 'h', "Highest priority gets id 0");
+    ASSERT_EQ(order_log[1] + order_log[2], 'a' + 'b', "Equal priorities come next");
+    ASSERT_EQ(order_log[3], 'l', "Lowest priority comes last");
+    ASSERT_EQ(order_log[4], 'd', "Dynamic task runs after the table");
+    
+    TEST_PASS();
+}
+
+TEST(test_dynamic_stack_pool) {
+    scheduler_init();
+    
+    ASSERT_EQ(scheduler_add_task(dynamic_task), 4, "One dynamic stack is reserved");
+    ASSERT_EQ(scheduler_add_task(dynamic_task), -1, "The dynamic stack pool is exhausted");
+    ASSERT_EQ(scheduler_get_task_count(), 5, "Failed add should not count");
+    
+    TEST_PASS();
+}
+
+int main(void) {
+    printf("\n");
+    printf("========================================\n");
+    printf("  AVR Scheduler Static Task Tests\n");
+    printf("========================================\n\n");
+    
+    RUN_TEST(test_static_table_loaded);
+    RUN_TEST(test_static_priority_order);
+    RUN_TEST(test_dynamic_stack_pool);
+    
+    // Print summary
+    printf("\n");
+    printf("Tests run:    %d\n", tests_run);
+    printf("Tests passed: %d\n", tests_passed);
+    printf("Tests failed: %d\n", tests_failed);
+    
+    if (tests_failed == 0) {
+        printf("\n✓ All tests passed!\n\n");
+        return 0;
+    } else {
+        printf("\n✗ Some tests failed!\n\n");
+        return 1;
+    }
+}
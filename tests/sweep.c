@@ -0,0 +1,683 @@
+/*
+ * Parameter sweep for schedulability testing
+ *
+ * Reads a task-set description, expands every combination of tick period,
+ * task order, periods, execution times and execution-time distributions,
+ * and simulates each configuration in virtual time on the host port.
+ * Configurations are spread over a thread pool, one reentrant scheduler
+ * instance per worker thread.
+ *
+ * Task-set file (one directive per line, '#' starts a comment):
+ *   tick US [US ...]          tick periods to try in microseconds
+ *   duration MS               simulated time per run in milliseconds
+ *   runs N                    runs per configuration (random seeds)
+ *   orders given|all          keep the listed task order or try every order
+ *   task NAME period=US[,US...] exec=MIN..MAX[,MIN..MAX...]
+ *        [dist=fixed|uniform|exp[,...]] [deadline=US]
+ *
+ * Every task is periodic: a job is released each period, runs for its
+ * sampled execution time without being preempted and then yields. The
+ * deadline is relative to the release and defaults to the period.
+ *
+ * The round-robin scheduler has no priorities; the task order decides
+ * which task is picked first when several become ready at the same tick.
+ *
+ * Output is CSV on stdout, one row per configuration.
+ *
+ * Usage: ./sweep [-j threads] taskset-file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Define mock AVR registers used by the scheduler core
+uint8_t mock_TCCR0A = 0;
+uint8_t mock_TCCR0B = 0;
+uint8_t mock_OCR0A = 0;
+uint8_t mock_TIMSK0 = 0;
+__thread uint8_t mock_SREG = 0;
+
+#include "../scheduler.h"
+#include "../port.h"
+
+#ifndef SCHEDULER_REENTRANT
+#error "sweep.c must be built with -DSCHEDULER_REENTRANT"
+#endif
+
+#ifndef SCHEDULER_CPU_LOAD
+#error "sweep.c needs SCHEDULER_CPU_LOAD for idle accounting"
+#endif
+
+// alternatives per swept task parameter
+#define MAX_CHOICES 8
+
+// upper bound on the number of expanded configurations
+#define MAX_CONFIGS 1000000UL
+
+// execution time distributions
+typedef enum {
+    DIST_FIXED,     // always the maximum
+    DIST_UNIFORM,   // uniform between minimum and maximum
+    DIST_EXP        // minimum plus exponential tail, truncated at maximum
+} dist_t;
+
+static const char *dist_names[] = {"fixed", "uniform", "exp"};
+
+// task as described in the task-set file
+typedef struct {
+    char name[16];
+    uint32_t period_us[MAX_CHOICES];
+    uint8_t period_count;
+    uint32_t exec_min_us[MAX_CHOICES];
+    uint32_t exec_max_us[MAX_CHOICES];
+    uint8_t exec_count;
+    dist_t dist[MAX_CHOICES];
+    uint8_t dist_count;
+    uint32_t deadline_us;   // 0 = period
+} taskset_task_t;
+
+// whole sweep description
+typedef struct {
+    uint32_t tick_us[MAX_CHOICES];
+    uint8_t tick_count;
+    uint32_t duration_ms;
+    uint32_t runs;
+    uint8_t all_orders;
+    taskset_task_t tasks[MAX_TASKS];
+    uint8_t task_count;
+} taskset_t;
+
+// one expanded configuration, indexed by scheduler task id
+typedef struct {
+    uint32_t tick_us;
+    uint8_t order[MAX_TASKS];   // task-set index of each task id
+    uint32_t period_us[MAX_TASKS];
+    uint32_t exec_min_us[MAX_TASKS];
+    uint32_t exec_max_us[MAX_TASKS];
+    dist_t dist[MAX_TASKS];
+    uint32_t deadline_us[MAX_TASKS];
+} config_t;
+
+// results of one configuration over all runs, indexed by task id
+typedef struct {
+    uint32_t jobs;
+    uint32_t misses;
+    uint32_t worst_response_us[MAX_TASKS];
+    uint32_t load_sum;          // sum of per-run cpu load in permille
+    uint16_t load_max;          // highest per-run cpu load in permille
+} result_t;
+
+// state of the simulation running on the calling thread
+typedef struct {
+    const config_t *config;
+    result_t *result;
+    uint32_t random;            // xorshift32 state
+    uint32_t carry_us[MAX_TASKS];
+} sim_t;
+
+static taskset_t taskset;
+static uint32_t order_count = 1;
+static uint32_t config_count = 1;
+
+// work queue shared by the thread pool
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t next_config = 0;
+static result_t *results = NULL;
+
+static __thread sim_t sim;
+
+// ============================================================================
+// Task-set parsing
+// ============================================================================
+
+// parse a comma-separated list of unsigned values
+static int parse_list(const char *text, uint32_t *values, uint8_t *count) {
+    *count = 0;
+    
+    while (*text != '\0') {
+        char *end;
+        unsigned long value = strtoul(text, &end, 10);
+        
+        if (end == text || *count >= MAX_CHOICES || value == 0) {
+            return -1;
+        }
+        
+        values[(*count)++] = (uint32_t)value;
+        text = (*end == ',') ? end + 1 : end;
+        
+        if (*end != ',' && *end != '\0') {
+            return -1;
+        }
+    }
+    
+    return (*count > 0) ? 0 : -1;
+}
+
+// parse a comma-separated list of MIN..MAX ranges (a single value is MIN = MAX)
+static int parse_ranges(const char *text, taskset_task_t *task) {
+    task->exec_count = 0;
+    
+    while (*text != '\0') {
+        char *end;
+        unsigned long min = strtoul(text, &end, 10);
+        unsigned long max = min;
+        
+        if (end == text || task->exec_count >= MAX_CHOICES) {
+            return -1;
+        }
+        
+        if (strncmp(end, "..", 2) == 0) {
+            text = end + 2;
+            max = strtoul(text, &end, 10);
+            if (end == text || max < min) {
+                return -1;
+            }
+        }
+        
+        task->exec_min_us[task->exec_count] = (uint32_t)min;
+        task->exec_max_us[task->exec_count] = (uint32_t)max;
+        task->exec_count++;
+        
+        if (*end != ',' && *end != '\0') {
+            return -1;
+        }
+        text = (*end == ',') ? end + 1 : end;
+    }
+    
+    return (task->exec_count > 0) ? 0 : -1;
+}
+
+// parse a comma-separated list of distribution names
+static int parse_dists(char *text, taskset_task_t *task) {
+    char *save;
+    
+    task->dist_count = 0;
+    
+    for (char *name = strtok_r(text, ",", &save); name != NULL;
+         name = strtok_r(NULL, ",", &save)) {
+        uint8_t found = 0;
+        
+        for (uint8_t i = 0; i < sizeof(dist_names) / sizeof(dist_names[0]); i++) {
+            if (strcmp(name, dist_names[i]) == 0 && task->dist_count < MAX_CHOICES) {
+                task->dist[task->dist_count++] = (dist_t)i;
+                found = 1;
+            }
+        }
+        
+        if (!found) {
+            return -1;
+        }
+    }
+    
+    return (task->dist_count > 0) ? 0 : -1;
+}
+
+// parse "NAME key=value ..." (the arguments of a task directive)
+static int parse_task(char *args) {
+    char *save;
+    char *name = strtok_r(args, " \t", &save);
+    
+    if (name == NULL || taskset.task_count >= MAX_TASKS) {
+        return -1;
+    }
+    
+    taskset_task_t *task = &taskset.tasks[taskset.task_count++];
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->dist[0] = DIST_UNIFORM;
+    task->dist_count = 1;
+    
+    for (char *option = strtok_r(NULL, " \t", &save); option != NULL;
+         option = strtok_r(NULL, " \t", &save)) {
+        char *value = strchr(option, '=');
+        int status;
+        
+        if (value == NULL) {
+            return -1;
+        }
+        *value++ = '\0';
+        
+        if (strcmp(option, "period") == 0) {
+            status = parse_list(value, task->period_us, &task->period_count);
+        } else if (strcmp(option, "exec") == 0) {
+            status = parse_ranges(value, task);
+        } else if (strcmp(option, "dist") == 0) {
+            status = parse_dists(value, task);
+        } else if (strcmp(option, "deadline") == 0) {
+            uint32_t deadline[MAX_CHOICES];
+            uint8_t count;
+            status = parse_list(value, deadline, &count);
+            status = (status == 0 && count == 1) ? 0 : -1;
+            task->deadline_us = deadline[0];
+        } else {
+            status = -1;
+        }
+        
+        if (status != 0) {
+            return -1;
+        }
+    }
+    
+    return (task->period_count > 0 && task->exec_count > 0) ? 0 : -1;
+}
+
+// read the task-set file, returns 0 on success
+static int load_taskset(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[512];
+    unsigned line_number = 0;
+    
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    
+    taskset.tick_us[0] = 1000;
+    taskset.tick_count = 1;
+    taskset.duration_ms = 10000;
+    taskset.runs = 1;
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *save;
+        char *comment = strchr(line, '#');
+        int status = 0;
+        
+        line_number++;
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        
+        char *directive = strtok_r(line, " \t\r\n", &save);
+        if (directive == NULL) {
+            continue;
+        }
+        
+        char *rest = strtok_r(NULL, "\r\n", &save);
+        char *args = (rest != NULL) ? rest : "";
+        
+        if (strcmp(directive, "tick") == 0) {
+            // accept "tick 500 1000" as well as "tick 500,1000"
+            for (char *c = args; *c != '\0'; c++) {
+                if (*c == ' ' || *c == '\t') {
+                    *c = ',';
+                }
+            }
+            status = parse_list(args, taskset.tick_us, &taskset.tick_count);
+        } else if (strcmp(directive, "duration") == 0) {
+            taskset.duration_ms = (uint32_t)strtoul(args, NULL, 10);
+            status = (taskset.duration_ms > 0) ? 0 : -1;
+        } else if (strcmp(directive, "runs") == 0) {
+            taskset.runs = (uint32_t)strtoul(args, NULL, 10);
+            status = (taskset.runs > 0) ? 0 : -1;
+        } else if (strcmp(directive, "orders") == 0) {
+            taskset.all_orders = (strncmp(args, "all", 3) == 0);
+            status = (taskset.all_orders || strncmp(args, "given", 5) == 0) ? 0 : -1;
+        } else if (strcmp(directive, "task") == 0) {
+            status = parse_task(args);
+        } else {
+            status = -1;
+        }
+        
+        if (status != 0) {
+            fprintf(stderr, "%s:%u: invalid '%s' directive\n", path, line_number, directive);
+            fclose(file);
+            return -1;
+        }
+    }
+    
+    fclose(file);
+    
+    if (taskset.task_count == 0) {
+        fprintf(stderr, "%s: no tasks\n", path);
+        return -1;
+    }
+    
+    return 0;
+}
+
+// ============================================================================
+// Configuration expansion
+// ============================================================================
+
+// multiply with overflow check against MAX_CONFIGS
+static int count_mul(uint32_t *count, uint32_t factor) {
+    if ((uint64_t)*count * factor > MAX_CONFIGS) {
+        return -1;
+    }
+    *count *= factor;
+    return 0;
+}
+
+// number of configurations in the sweep
+static int count_configs(void) {
+    config_count = 1;
+    order_count = 1;
+    
+    if (taskset.all_orders) {
+        for (uint32_t i = 2; i <= taskset.task_count; i++) {
+            order_count *= i;
+        }
+    }
+    
+    if (count_mul(&config_count, taskset.tick_count) != 0 ||
+        count_mul(&config_count, order_count) != 0) {
+        return -1;
+    }
+    
+    for (uint8_t i = 0; i < taskset.task_count; i++) {
+        const taskset_task_t *task = &taskset.tasks[i];
+        
+        if (count_mul(&config_count, task->period_count) != 0 ||
+            count_mul(&config_count, task->exec_count) != 0 ||
+            count_mul(&config_count, task->dist_count) != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// decode a configuration index (mixed radix over every swept parameter)
+static void expand_config(uint32_t index, config_t *config) {
+    uint8_t period[MAX_TASKS];
+    uint8_t exec[MAX_TASKS];
+    uint8_t dist[MAX_TASKS];
+    uint8_t remaining[MAX_TASKS];
+    
+    // last task varies fastest
+    for (int8_t i = (int8_t)taskset.task_count - 1; i >= 0; i--) {
+        const taskset_task_t *task = &taskset.tasks[i];
+        
+        dist[i] = index % task->dist_count;
+        index /= task->dist_count;
+        exec[i] = index % task->exec_count;
+        index /= task->exec_count;
+        period[i] = index % task->period_count;
+        index /= task->period_count;
+    }
+    
+    uint32_t order = index % order_count;
+    index /= order_count;
+    config->tick_us = taskset.tick_us[index];
+    
+    // order-th permutation in lexicographic order (factorial number system)
+    // with a single order this is the task-set order
+    for (uint8_t i = 0; i < taskset.task_count; i++) {
+        remaining[i] = i;
+    }
+    
+    uint32_t radix = order_count;
+    for (uint8_t i = 0; i < taskset.task_count; i++) {
+        uint8_t left = taskset.task_count - i;
+        uint8_t pick = 0;
+        
+        if (taskset.all_orders) {
+            radix /= left;
+            pick = (uint8_t)(order / radix);
+            order %= radix;
+        }
+        
+        config->order[i] = remaining[pick];
+        memmove(&remaining[pick], &remaining[pick + 1], left - pick - 1);
+    }
+    
+    for (uint8_t id = 0; id < taskset.task_count; id++) {
+        uint8_t t = config->order[id];
+        const taskset_task_t *task = &taskset.tasks[t];
+        
+        config->period_us[id] = task->period_us[period[t]];
+        config->exec_min_us[id] = task->exec_min_us[exec[t]];
+        config->exec_max_us[id] = task->exec_max_us[exec[t]];
+        config->dist[id] = task->dist[dist[t]];
+        config->deadline_us[id] = task->deadline_us ? task->deadline_us : config->period_us[id];
+    }
+}
+
+// ============================================================================
+// Simulation
+// ============================================================================
+
+// xorshift32 pseudo random number
+static uint32_t sim_random(void) {
+    uint32_t x = sim.random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim.random = x;
+    return x;
+}
+
+// sample the execution time of the next job of a task
+static uint32_t sim_exec_time(uint8_t id) {
+    uint32_t min = sim.config->exec_min_us[id];
+    uint32_t max = sim.config->exec_max_us[id];
+    
+    switch (sim.config->dist[id]) {
+    case DIST_UNIFORM:
+        return min + sim_random() % (max - min + 1);
+    
+    case DIST_EXP: {
+        // inverse transform, mean of the tail a quarter of the range
+        double u = (sim_random() + 1.0) / 4294967297.0;
+        double tail = -log(u) * (max - min) / 4.0;
+        return (tail >= max - min) ? max : min + (uint32_t)tail;
+    }
+    
+    case DIST_FIXED:
+    default:
+        return max;
+    }
+}
+
+// periodic task body shared by every simulated task
+static void sim_task(void) {
+    uint8_t id = scheduler_get_current_task();
+    uint32_t tick_us = sim.config->tick_us;
+    uint64_t release_us = 0;
+    
+    while (1) {
+        uint32_t release = (uint32_t)(release_us / tick_us);
+        uint32_t now = port_host_get_ticks();
+        
+        // wait for the next release
+        if (now < release) {
+            uint32_t wait = release - now;
+            task_delay(wait > UINT16_MAX ? UINT16_MAX : (uint16_t)wait);
+            continue;
+        }
+        
+        // run the job without preemption, carrying sub-tick remainders
+        sim.carry_us[id] += sim_exec_time(id);
+        port_host_advance(sim.carry_us[id] / tick_us);
+        sim.carry_us[id] %= tick_us;
+        
+        uint32_t response_us = (port_host_get_ticks() - release) * tick_us;
+        
+        sim.result->jobs++;
+        if (response_us > sim.config->deadline_us[id]) {
+            sim.result->misses++;
+        }
+        if (response_us > sim.result->worst_response_us[id]) {
+            sim.result->worst_response_us[id] = response_us;
+        }
+        
+        release_us += sim.config->period_us[id];
+        scheduler_yield();
+    }
+}
+
+// run every seed of one configuration on the calling thread's scheduler
+static void sim_config(uint32_t index, result_t *result) {
+    config_t config;
+    
+    expand_config(index, &config);
+    memset(result, 0, sizeof(*result));
+    sim.config = &config;
+    sim.result = result;
+    
+    uint32_t ticks = (uint32_t)((uint64_t)taskset.duration_ms * 1000u / config.tick_us);
+    
+    for (uint32_t run = 0; run < taskset.runs; run++) {
+        // reproducible per configuration and run, never zero
+        sim.random = (index * 2654435761u) ^ (run * 40503u) ^ 0x9E3779B9u;
+        if (sim.random == 0) {
+            sim.random = 1;
+        }
+        memset(sim.carry_us, 0, sizeof(sim.carry_us));
+        
+        scheduler_init();
+        for (uint8_t id = 0; id < taskset.task_count; id++) {
+            scheduler_add_task(sim_task);
+        }
+        
+        port_host_set_virtual_time(1);
+        port_host_set_tick_limit(ticks);
+        scheduler_start();
+        
+        uint32_t total = port_host_get_ticks();
+        uint32_t busy = total - scheduler_get_idle_ticks();
+        uint16_t load = (uint16_t)((uint64_t)busy * 1000u / total);
+        
+        result->load_sum += load;
+        if (load > result->load_max) {
+            result->load_max = load;
+        }
+    }
+}
+
+// thread pool worker: take configurations until none are left
+static void *sweep_worker(void *arg) {
+    scheduler_t *instance = scheduler_create();
+    
+    (void)arg;
+    if (instance == NULL) {
+        return NULL;
+    }
+    scheduler_set_instance(instance);
+    
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        uint32_t index = next_config++;
+        pthread_mutex_unlock(&queue_lock);
+        
+        if (index >= config_count) {
+            break;
+        }
+        
+        sim_config(index, &results[index]);
+    }
+    
+    scheduler_set_instance(NULL);
+    scheduler_destroy(instance);
+    return NULL;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static void print_report(void) {
+    printf("config,tick_us,order");
+    for (uint8_t i = 0; i < taskset.task_count; i++) {
+        const char *name = taskset.tasks[i].name;
+        printf(",%s_period_us,%s_exec_us,%s_dist", name, name, name);
+    }
+    printf(",jobs,misses");
+    for (uint8_t i = 0; i < taskset.task_count; i++) {
+        printf(",%s_worst_response_us", taskset.tasks[i].name);
+    }
+    printf(",cpu_load_mean_permille,cpu_load_max_permille\n");
+    
+    for (uint32_t index = 0; index < config_count; index++) {
+        const result_t *result = &results[index];
+        uint32_t worst[MAX_TASKS];
+        config_t config;
+        
+        expand_config(index, &config);
+        printf("%u,%u,", index, config.tick_us);
+        
+        // columns follow the task-set order, whatever the task ids are
+        for (uint8_t id = 0; id < taskset.task_count; id++) {
+            printf("%s%s", id ? ">" : "", taskset.tasks[config.order[id]].name);
+            worst[config.order[id]] = result->worst_response_us[id];
+        }
+        
+        for (uint8_t i = 0; i < taskset.task_count; i++) {
+            uint8_t id = 0;
+            while (config.order[id] != i) {
+                id++;
+            }
+            printf(",%u,%u..%u,%s", config.period_us[id], config.exec_min_us[id],
+                   config.exec_max_us[id], dist_names[config.dist[id]]);
+        }
+        
+        printf(",%u,%u", result->jobs, result->misses);
+        for (uint8_t i = 0; i < taskset.task_count; i++) {
+            printf(",%u", worst[i]);
+        }
+        printf(",%u,%u\n", result->load_sum / taskset.runs, result->load_max);
+    }
+}
+
+int main(int argc, char **argv) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "j:")) != -1) {
+        if (opt == 'j') {
+            threads = strtol(optarg, NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-j threads] taskset-file\n", argv[0]);
+            return 2;
+        }
+    }
+    
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-j threads] taskset-file\n", argv[0]);
+        return 2;
+    }
+    
+    if (load_taskset(argv[optind]) != 0) {
+        return 1;
+    }
+    
+    if (count_configs() != 0) {
+        fprintf(stderr, "sweep: more than %lu configurations\n", MAX_CONFIGS);
+        return 1;
+    }
+    
+    if (threads < 1) {
+        threads = 1;
+    }
+    
+    results = calloc(config_count, sizeof(result_t));
+    pthread_t *pool = calloc((size_t)threads, sizeof(pthread_t));
+    if (results == NULL || pool == NULL) {
+        fprintf(stderr, "sweep: out of memory\n");
+        return 1;
+    }
+    
+    fprintf(stderr, "sweep: %u configurations x %u runs on %ld threads\n",
+            config_count, taskset.runs, threads);
+    
+    for (long i = 0; i < threads; i++) {
+        if (pthread_create(&pool[i], NULL, sweep_worker, NULL) != 0) {
+            fprintf(stderr, "sweep: cannot start thread\n");
+            return 1;
+        }
+    }
+    
+    for (long i = 0; i < threads; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    
+    print_report();
+    
+    free(pool);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Host formatter for the deferred log stream (see log.h)
+
+Reads the .logstr format string table from the firmware ELF and decodes
+the binary records drained by log_drain() from a serial port or a file.
+
+Usage:
+    tools/logfmt.py led_example.elf /dev/ttyUSB0 [baud]
+    tools/logfmt.py led_example.elf capture.bin
+"""
+
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+LOG_SYNC = 0xA5
+LOG_HEADER_SIZE = 4
+LOG_MAX_ARGS = 8
+
+# printf conversion -> (argument size on avr, struct format)
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|l)?([diuxXoc%])")
+
+
+def load_strings(elf, objcopy="avr-objcopy"):
+    """Return {id: format string} from the .logstr section of an ELF."""
+    with tempfile.TemporaryDirectory() as tmp:
+        out = os.path.join(tmp, "logstr.bin")
+        subprocess.run([objcopy, "-O", "binary", "--only-section=.logstr",
+                        "--set-section-flags", ".logstr=alloc", elf, out],
+                       check=True)
+        with open(out, "rb") as f:
+            table = f.read()
+
+    strings = {}
+    offset = 0
+    while offset < len(table):
+        end = table.index(b"\0", offset)
+        strings[offset] = table[offset:end].decode("ascii", "replace")
+        offset = end + 1
+    return strings
+
+
+def format_record(fmt, payload):
+    """Render one record using avr-gcc argument sizes."""
+    pos = 0
+    out = []
+    last = 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if conv == "c" or length == "hh":
+            size = 1
+        elif length == "l":
+            size = 4
+        else:
+            size = 2
+        raw = payload[pos:pos + size]
+        pos += size
+        if len(raw) < size:
+            out.append("<?>")
+            continue
+        signed = conv in "di"
+        code = {1: "b", 2: "h", 4: "i"}[size]
+        value = struct.unpack("<" + (code if signed else code.upper()), raw)[0]
+        if conv == "c":
+            out.append(chr(value))
+        else:
+            out.append(("%" + flags + conv.replace("u", "d")) % value)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def decode(stream, strings):
+    """Yield formatted lines from a byte stream, resyncing on LOG_SYNC."""
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buf += chunk
+        while buf:
+            if buf[0] != LOG_SYNC:
+                del buf[0]
+                continue
+            if len(buf) < LOG_HEADER_SIZE:
+                break
+            ident = buf[1] | (buf[2] << 8)
+            length = buf[3]
+            if ident not in strings or length > LOG_MAX_ARGS:
+                # not a record start, keep searching
+                del buf[0]
+                continue
+            if len(buf) < LOG_HEADER_SIZE + length:
+                break
+            payload = bytes(buf[LOG_HEADER_SIZE:LOG_HEADER_SIZE + length])
+            del buf[:LOG_HEADER_SIZE + length]
+            yield format_record(strings[ident], payload)
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    strings = load_strings(argv[1])
+    source = argv[2]
+
+    if os.path.exists(source) and not source.startswith("/dev/"):
+        stream = open(source, "rb")
+    else:
+        import serial  # pyserial
+        baud = int(argv[3]) if len(argv) > 3 else 115200
+        stream = serial.Serial(source, baud)
+
+    for line in decode(stream, strings):
+        print(line.rstrip("\n"), flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
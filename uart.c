@@ -0,0 +1,310 @@
+#include "uart.h"
+#include "scheduler.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if (UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) != 0 || UART_TX_BUFFER_SIZE > 128
+#error "UART_TX_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
+#if (UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) != 0 || UART_RX_BUFFER_SIZE > 128
+#error "UART_RX_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
+// parts with several usarts name the vectors after usart0
+#if defined(USART0_RX_vect)
+#define UART_RX_vect USART0_RX_vect
+#define UART_UDRE_vect USART0_UDRE_vect
+#else
+#define UART_RX_vect USART_RX_vect
+#define UART_UDRE_vect USART_UDRE_vect
+#endif
+
+#define TX_MASK (UART_TX_BUFFER_SIZE - 1)
+#define RX_MASK (UART_RX_BUFFER_SIZE - 1)
+
+// one bit per task id in a waiter set
+#define WAITER_BYTES ((MAX_TASKS + 7) / 8)
+
+// tasks blocked on the same condition
+// any is set while a bit is set, so the isrs skip the scan when no task waits
+typedef struct {
+    uint8_t any;
+    uint8_t bits[WAITER_BYTES];
+} uart_waiters_t;
+
+// ring buffers with free-running 8-bit indices
+// head is advanced by the producer, tail by the consumer
+static uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+// tasks blocked on a full tx buffer or an empty rx buffer
+static volatile uart_waiters_t tx_waiters;
+static volatile uart_waiters_t rx_waiters;
+
+// set from handing a byte to the hardware until txc0 reports it sent
+static volatile uint8_t tx_shifting = 0;
+
+// add the current task to a waiter set (interrupts disabled)
+static void waiters_add(volatile uart_waiters_t *waiters) {
+    task_id_t id = scheduler_get_current_task();
+    
+    waiters->bits[id >> 3] |= (uint8_t)(1 << (id & 7));
+    waiters->any = 1;
+}
+
+// wake every task in a waiter set and empty it (isr or interrupts disabled)
+// each woken task re-checks its condition and blocks again if it still holds
+static void waiters_wake(volatile uart_waiters_t *waiters) {
+    if (!waiters->any) {
+        return;
+    }
+    waiters->any = 0;
+    
+    for (uint8_t i = 0; i < WAITER_BYTES; i++) {
+        uint8_t bits = waiters->bits[i];
+        
+        if (bits == 0) {
+            continue;
+        }
+        waiters->bits[i] = 0;
+        
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (bits & (1 << bit)) {
+                scheduler_wake_task((task_id_t)(i * 8 + bit));
+            }
+        }
+    }
+}
+
+// empty a waiter set
+static void waiters_clear(volatile uart_waiters_t *waiters) {
+    waiters->any = 0;
+    for (uint8_t i = 0; i < WAITER_BYTES; i++) {
+        waiters->bits[i] = 0;
+    }
+}
+
+// initialize usart0
+void uart_init(uint32_t baud) {
+    // double speed mode halves the baud rate error at high rates
+    uint16_t ubrr = (uint16_t)((F_CPU + 4UL * baud) / (8UL * baud) - 1);
+    
+    tx_head = 0;
+    tx_tail = 0;
+    rx_head = 0;
+    rx_tail = 0;
+    waiters_clear(&tx_waiters);
+    waiters_clear(&rx_waiters);
+    tx_shifting = 0;
+    
+    UBRR0H = (uint8_t)(ubrr >> 8);
+    UBRR0L = (uint8_t)ubrr;
+    UCSR0A = (1 << U2X0);
+    
+    // enable receiver, transmitter and rx interrupt
+    // the udre interrupt is enabled only while tx data is queued
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+    
+    // set frame format: 8 data bits, 1 stop bit, no parity
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+}
+
+// move the next queued byte to the hardware (udre isr or polling)
+static void tx_send_next(void) {
+    uint8_t tail = tx_tail;
+    
+    if (tx_head == tail) {
+        // nothing left - stop udre interrupts until more data is queued
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+    
+    UDR0 = tx_buffer[tail & TX_MASK];
+    tx_tail = ++tail;
+    
+    // txc0 cannot set again before this byte is out, clear the stale flag
+    // (writing one clears it, the other writable bits keep their value)
+    UCSR0A |= (1 << TXC0);
+    tx_shifting = 1;
+    
+    // wake the writers once half of the buffer is free again
+    if ((uint8_t)(tx_head - tail) <= UART_TX_BUFFER_SIZE / 2) {
+        waiters_wake(&tx_waiters);
+    }
+}
+
+// store a received byte (rx isr or polling)
+static void rx_receive(void) {
+    uint8_t byte = UDR0;
+    uint8_t head = rx_head;
+    
+    // drop the byte if the buffer is full
+    if ((uint8_t)(head - rx_tail) < UART_RX_BUFFER_SIZE) {
+        rx_buffer[head & RX_MASK] = byte;
+        rx_head = head + 1;
+    }
+    
+    waiters_wake(&rx_waiters);
+}
+
+// transmit data register empty - send next byte
+ISR(UART_UDRE_vect) {
+    tx_send_next();
+}
+
+// receive complete - buffer the byte
+ISR(UART_RX_vect) {
+    rx_receive();
+}
+
+// queue bytes for transmission
+void uart_write(const uint8_t *data, uint8_t len) {
+    while (len > 0) {
+        uint8_t head = tx_head;
+        uint8_t space = UART_TX_BUFFER_SIZE - (uint8_t)(head - tx_tail);
+        
+        if (space == 0) {
+            uint8_t sreg = SREG;
+            cli();
+            
+            if (!scheduler_is_running()) {
+                // before the scheduler starts interrupts may be off: poll
+                if (UCSR0A & (1 << UDRE0)) {
+                    tx_send_next();
+                }
+            } else if ((uint8_t)(tx_head - tx_tail) == UART_TX_BUFFER_SIZE) {
+                // still full with interrupts off, so the wakeup cannot be missed
+                waiters_add(&tx_waiters);
+                scheduler_block_current();
+                SREG = sreg;
+                scheduler_yield();
+                continue;
+            }
+            
+            SREG = sreg;
+            continue;
+        }
+        
+        // single producer: only tasks write, the isr only moves the tail
+        while (space > 0 && len > 0) {
+            tx_buffer[head & TX_MASK] = *data++;
+            head++;
+            space--;
+            len--;
+        }
+        
+        tx_head = head;
+        
+        // start (or keep) the udre interrupt draining the buffer
+        UCSR0B |= (1 << UDRIE0);
+    }
+}
+
+// queue one character
+void uart_putc(char c) {
+    uart_write((const uint8_t *)&c, 1);
+}
+
+// queue a string
+void uart_puts(const char *s) {
+    while (*s) {
+        if (*s == '\n') {
+            uart_putc('\r');
+        }
+        uart_putc(*s++);
+    }
+}
+
+// wait until the tx buffer is empty
+void uart_flush(void) {
+    while (tx_head != tx_tail) {
+        if (scheduler_is_running()) {
+            task_delay(1);
+        } else {
+            uint8_t sreg = SREG;
+            cli();
+            if (UCSR0A & (1 << UDRE0)) {
+                tx_send_next();
+            }
+            SREG = sreg;
+        }
+    }
+}
+
+// read received bytes
+uint8_t uart_read(uint8_t *buf, uint8_t len) {
+    uint8_t count = 0;
+    
+    if (len == 0) {
+        return 0;
+    }
+    
+    uint8_t sreg = SREG;
+    cli();
+    
+    while (rx_head == rx_tail) {
+        if (!scheduler_is_running()) {
+            // before the scheduler starts interrupts may be off: poll
+            if (UCSR0A & (1 << RXC0)) {
+                rx_receive();
+            }
+            continue;
+        }
+        
+        // still empty with interrupts off, so the wakeup cannot be missed
+        waiters_add(&rx_waiters);
+        scheduler_block_current();
+        SREG = sreg;
+        scheduler_yield();
+        sreg = SREG;
+        cli();
+    }
+    
+    SREG = sreg;
+    
+    // single consumer: only tasks read, the isr only moves the head
+    uint8_t tail = rx_tail;
+    while (count < len && tail != rx_head) {
+        buf[count++] = rx_buffer[tail & RX_MASK];
+        tail++;
+    }
+    rx_tail = tail;
+    
+    return count;
+}
+
+// read one byte
+uint8_t uart_getc(void) {
+    uint8_t byte;
+    uart_read(&byte, 1);
+    return byte;
+}
+
+// get number of buffered rx bytes
+uint8_t uart_available(void) {
+    return (uint8_t)(rx_head - rx_tail);
+}
+
+// check if sleeping with the usart clock stopped would break a transfer
+uint8_t uart_idle_busy(void) {
+    // queued bytes, or a task waiting for a byte that could not wake it
+    if (tx_head != tx_tail || rx_waiters.any) {
+        return 1;
+    }
+    
+    // the last byte is still in the shift register
+    if (tx_shifting) {
+        if (!(UCSR0A & (1 << TXC0))) {
+            return 1;
+        }
+        tx_shifting = 0;
+    }
+    
+    return 0;
+}
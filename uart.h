@@ -0,0 +1,50 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+// interrupt-driven uart driver (usart0)
+// transmit and receive use ring buffers serviced by the udre and rx
+// interrupts; tasks block only when the tx buffer is full or no rx data
+// is available, other tasks keep running meanwhile. several tasks may
+// wait on the same buffer, all of them are woken and re-check it
+
+// transmit buffer size in bytes (power of two, at most 128)
+#define UART_TX_BUFFER_SIZE 64
+
+// receive buffer size in bytes (power of two, at most 128)
+#define UART_RX_BUFFER_SIZE 32
+
+// initialize usart0 with 8 data bits, 1 stop bit, no parity
+void uart_init(uint32_t baud);
+
+// queue len bytes for transmission
+// blocks the calling task only while the tx buffer is full
+void uart_write(const uint8_t *data, uint8_t len);
+
+// queue one character
+void uart_putc(char c);
+
+// queue a string, translating '\n' to "\r\n"
+void uart_puts(const char *s);
+
+// block until all queued bytes have been handed to the hardware
+void uart_flush(void);
+
+// read up to len bytes, blocking until at least one byte is available
+// returns the number of bytes read
+uint8_t uart_read(uint8_t *buf, uint8_t len);
+
+// read one byte, blocking until it is available
+uint8_t uart_getc(void);
+
+// number of received bytes waiting to be read
+uint8_t uart_available(void);
+
+// returns non-zero while a byte is queued or being sent, or a task waits
+// for received data. sleep modes that stop the usart clock (power-save)
+// must not be entered then, port_idle() checks it (call with interrupts
+// disabled)
+uint8_t uart_idle_busy(void);
+
+#endif // UART_H
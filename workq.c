@@ -0,0 +1,107 @@
+#include "workq.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stddef.h>
+
+#if (WORKQ_SIZE & (WORKQ_SIZE - 1)) != 0 || WORKQ_SIZE > 128
+#error "WORKQ_SIZE must be a power of two no larger than 128"
+#endif
+
+#define WORKQ_INDEX_MASK (WORKQ_SIZE - 1)
+
+// one posted function call
+typedef struct {
+    work_func_t function;
+    void *arg;
+} work_t;
+
+// ring with free-running 8-bit indices
+// head is only advanced by producers, tail only by the worker
+static work_t workq_items[WORKQ_SIZE];
+static volatile uint8_t workq_head = 0;
+static volatile uint8_t workq_tail = 0;
+static volatile uint16_t workq_dropped = 0;
+
+// worker task, -1 until workq_init()
+static task_sid_t workq_task_id = -1;
+
+// worker task, runs the posted functions
+static void workq_task(void) {
+    while (1) {
+        // one batch: everything posted before this turn
+        uint8_t head = workq_head;
+        uint8_t tail = workq_tail;
+        
+        while (tail != head) {
+            work_t work = workq_items[tail & WORKQ_INDEX_MASK];
+            
+            // lock-free: the slot is free again once the tail has moved
+            workq_tail = ++tail;
+            work.function(work.arg);
+        }
+        
+        // sleep once the queue is empty, workq_post() wakes this task
+        uint8_t sreg = SREG;
+        cli();
+        if (workq_head == workq_tail) {
+            scheduler_block_current();
+        }
+        SREG = sreg;
+        
+        scheduler_yield();
+    }
+}
+
+// empty the queue and add the worker task
+int8_t workq_init(void) {
+    workq_head = 0;
+    workq_tail = 0;
+    workq_dropped = 0;
+    
+    workq_task_id = scheduler_add_task(workq_task);
+    if (workq_task_id < 0) {
+        return -1;
+    }
+    
+    return 0;
+}
+
+// queue a function call
+int8_t workq_post(work_func_t function, void *arg) {
+    if (function == NULL || workq_task_id < 0) {
+        return -1;
+    }
+    
+    // avr has no compare-and-swap, so producers (tasks and nested isrs)
+    // are serialised by a critical section of a few instructions
+    uint8_t sreg = SREG;
+    cli();
+    
+    uint8_t head = workq_head;
+    
+    if ((uint8_t)(head - workq_tail) >= WORKQ_SIZE) {
+        workq_dropped++;
+        SREG = sreg;
+        return -1;
+    }
+    
+    workq_items[head & WORKQ_INDEX_MASK].function = function;
+    workq_items[head & WORKQ_INDEX_MASK].arg = arg;
+    
+    // publish the entry to the worker
+    workq_head = head + 1;
+    scheduler_wake_task((task_id_t)workq_task_id);
+    
+    SREG = sreg;
+    return 0;
+}
+
+// get dropped post count
+uint16_t workq_get_dropped(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t dropped = workq_dropped;
+    SREG = sreg;
+    
+    return dropped;
+}
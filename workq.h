@@ -0,0 +1,31 @@
+#ifndef WORKQ_H
+#define WORKQ_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+// deferred interrupt work (bottom halves)
+// an isr posts a function and an argument and returns, one worker task
+// calls the posted functions later in task context, in posting order
+// so isrs stay short and deferred work is serialised without a task per
+// interrupt source. the worker runs everything posted before its turn,
+// then gives the other tasks a turn
+
+// queue size in entries (power of two, at most 128)
+#define WORKQ_SIZE 16
+
+// deferred work function, gets the argument given to workq_post()
+typedef void (*work_func_t)(void *arg);
+
+// empty the queue and add the worker task, call after scheduler_init()
+// returns 0 on success, -1 if the worker task could not be added
+int8_t workq_init(void);
+
+// queue a function call, safe to call from tasks and isrs
+// returns 0 on success, -1 if it was dropped (queue full)
+int8_t workq_post(work_func_t function, void *arg);
+
+// get number of posts dropped because the queue was full
+uint16_t workq_get_dropped(void);
+
+#endif // WORKQ_H